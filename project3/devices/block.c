@@ -19,6 +19,8 @@ struct block {
 
     unsigned long long             read_cnt;  /* Number of sectors read. */
     unsigned long long             write_cnt; /* Number of sectors written. */
+    unsigned long long             hit_cnt;   /* Buffer cache hits. */
+    unsigned long long             miss_cnt;  /* Buffer cache misses. */
 };
 
 /* List of all block devices. */
@@ -171,10 +173,27 @@ block_print_stats(void)
             printf("%s (%s): %llu reads, %llu writes\n",
                    block->name, block_type_name(block->type),
                    block->read_cnt, block->write_cnt);
+            if (block->hit_cnt + block->miss_cnt > 0) {
+                printf("%s (%s): %llu cache hits, %llu cache misses\n",
+                       block->name, block_type_name(block->type),
+                       block->hit_cnt, block->miss_cnt);
+            }
         }
     }
 }
 
+/* Records a buffer cache lookup for a sector of BLOCK, which HIT
+ * or missed the cache, for block_print_stats(). */
+void
+block_count_cache(struct block *block, bool hit)
+{
+    if (hit) {
+        block->hit_cnt++;
+    } else {
+        block->miss_cnt++;
+    }
+}
+
 /* Registers a new block device with the given NAME.  If
  * EXTRA_INFO is non-null, it is printed as part of a user
  * message.  The block device's SIZE in sectors and its TYPE must
@@ -199,6 +218,8 @@ block_register(const char *name, enum block_type type,
     block->aux = aux;
     block->read_cnt = 0;
     block->write_cnt = 0;
+    block->hit_cnt = 0;
+    block->miss_cnt = 0;
 
     printf("%s: %'"PRDSNu " sectors (", block->name, block->size);
     print_human_readable_size((uint64_t)block->size * BLOCK_SECTOR_SIZE);
@@ -2,6 +2,7 @@
 #define DEVICES_BLOCK_H
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 /* Size of a block device sector in bytes.
@@ -56,6 +57,7 @@ enum block_type block_type(struct block *);
 
 /* Statistics. */
 void block_print_stats(void);
+void block_count_cache(struct block *, bool hit);
 
 /* Lower-level interface to block device drivers. */
 
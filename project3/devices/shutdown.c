@@ -9,11 +9,15 @@
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/syscall.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/swap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -90,6 +94,8 @@ shutdown_power_off(void)
     const char *p;
 
 #ifdef FILESYS
+    /* Walking the file system needs it still open. */
+    filesys_print_stats();
     filesys_done();
 #endif
 
@@ -136,5 +142,9 @@ print_stats(void)
     kbd_print_stats();
 #ifdef USERPROG
     exception_print_stats();
+    syscall_print_stats();
+#endif
+#ifdef VM
+    swap_print_stats();
 #endif
 }
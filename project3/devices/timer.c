@@ -1,5 +1,6 @@
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 
@@ -25,9 +26,17 @@ static int64_t ticks;
  * Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* List of threads blocked in timer_sleep(), ordered by
+ * increasing wakeup_tick.  Threads with equal wakeup ticks are
+ * kept in the order in which they went to sleep.  Accessed only
+ * with interrupts off. */
+static struct list sleep_list;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops(unsigned loops);
 
+static list_less_func wakeup_less;
+
 static void busy_wait(int64_t loops);
 
 static void real_time_sleep(int64_t num, int32_t denom);
@@ -40,6 +49,7 @@ void
 timer_init(void)
 {
     pit_configure_channel(0, 2, TIMER_FREQ);
+    list_init(&sleep_list);
     intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -91,16 +101,27 @@ timer_elapsed(int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
- * be turned on. */
+ * be turned on.
+ *
+ * The running thread is queued on sleep_list and blocked; it is
+ * unblocked by timer_interrupt() once its wake-up tick arrives,
+ * so sleeping threads consume no CPU time in the meantime. */
 void
 timer_sleep(int64_t ticks)
 {
-    int64_t start = timer_ticks();
+    struct thread *cur = thread_current();
+    enum intr_level old_level;
 
     ASSERT(intr_get_level() == INTR_ON);
-    while (timer_elapsed(start) < ticks) {
-        thread_yield();
+    if (ticks <= 0) {
+        return;
     }
+
+    old_level = intr_disable();
+    cur->wakeup_tick = timer_ticks() + ticks;
+    list_insert_ordered(&sleep_list, &cur->elem, wakeup_less, NULL);
+    thread_block();
+    intr_set_level(old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -178,9 +199,33 @@ static void
 timer_interrupt(struct intr_frame *args UNUSED)
 {
     ticks++;
+
+    /* Wake every sleeper whose time has come.  The list is sorted,
+     * so we stop at the first thread that must keep sleeping. */
+    while (!list_empty(&sleep_list)) {
+        struct thread *t = list_entry(list_front(&sleep_list),
+                                      struct thread, elem);
+        if (t->wakeup_tick > ticks) {
+            break;
+        }
+        list_pop_front(&sleep_list);
+        thread_unblock(t);
+    }
+
     thread_tick();
 }
 
+/* Orders sleeping threads by increasing wake-up tick. */
+static bool
+wakeup_less(const struct list_elem *a_, const struct list_elem *b_,
+            void *aux UNUSED)
+{
+    const struct thread *a = list_entry(a_, struct thread, elem);
+    const struct thread *b = list_entry(b_, struct thread, elem);
+
+    return a->wakeup_tick < b->wakeup_tick;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
  * tick, otherwise false. */
 static bool
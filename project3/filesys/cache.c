@@ -0,0 +1,334 @@
+#include <debug.h>
+#include <string.h>
+
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Ticks between two passes of the flush daemon. */
+#define CACHE_FLUSH_INTERVAL (5 * TIMER_FREQ)
+
+/* Maximum number of pending read-ahead requests. */
+#define READ_AHEAD_QUEUE 32
+
+/* Sector number marking a cache slot that holds no sector. */
+#define CACHE_NO_SECTOR ((block_sector_t) -1)
+
+/* A cached sector.
+ *
+ * SECTOR, FLUSHING, PIN_CNT and ACCESSED are protected by
+ * cache_lock.  DATA and DIRTY are protected by the entry's own
+ * LOCK, which is only ever held by a thread that has the entry
+ * pinned.  A pinned entry is never chosen for eviction, so an
+ * unpinned entry's LOCK is always free. */
+struct cache_entry {
+    block_sector_t sector;          /* Cached sector, or CACHE_NO_SECTOR. */
+    block_sector_t flushing;        /* Old sector being written back. */
+    int            pin_cnt;         /* Threads using the entry. */
+    bool           accessed;        /* Used since the clock hand passed. */
+    bool           dirty;           /* DATA differs from disk. */
+    struct lock    lock;            /* Guards DATA and DIRTY. */
+    uint8_t        data[BLOCK_SECTOR_SIZE]; /* Sector contents. */
+};
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;      /* Guards the slot bookkeeping. */
+static struct condition cache_changed; /* An entry was unpinned or flushed. */
+static size_t clock_hand;           /* Next eviction candidate. */
+
+/* Sectors waiting to be prefetched, as a ring buffer. */
+static block_sector_t ra_queue[READ_AHEAD_QUEUE];
+static size_t ra_head;              /* Next request to serve. */
+static size_t ra_cnt;               /* Number of queued requests. */
+static struct lock ra_lock;         /* Guards the queue. */
+static struct condition ra_queued;  /* A request was queued. */
+
+static struct cache_entry *cache_get(block_sector_t, bool overwrite);
+static void cache_put(struct cache_entry *);
+static struct cache_entry *cache_lookup(block_sector_t);
+static bool cache_flushing(block_sector_t);
+static struct cache_entry *cache_evict(void);
+static void flush_daemon(void *aux);
+static void read_ahead_daemon(void *aux);
+
+/* Initializes the buffer cache and starts the thread that
+ * periodically writes dirty sectors back to disk. */
+void
+cache_init(void)
+{
+    size_t i;
+
+    lock_init(&cache_lock);
+    cond_init(&cache_changed);
+    for (i = 0; i < CACHE_SIZE; i++) {
+        struct cache_entry *e = &cache[i];
+        e->sector = CACHE_NO_SECTOR;
+        e->flushing = CACHE_NO_SECTOR;
+        e->pin_cnt = 0;
+        e->accessed = false;
+        e->dirty = false;
+        lock_init(&e->lock);
+    }
+    clock_hand = 0;
+
+    lock_init(&ra_lock);
+    cond_init(&ra_queued);
+    ra_head = ra_cnt = 0;
+
+    thread_create("cache-flush", PRI_DEFAULT, flush_daemon, NULL);
+    thread_create("cache-read-ahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+}
+
+/* Copies SIZE bytes starting at byte OFS of SECTOR into
+ * BUFFER, reading the sector into the cache if necessary. */
+void
+cache_read(block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+    struct cache_entry *e;
+
+    ASSERT(ofs + size <= BLOCK_SECTOR_SIZE);
+
+    e = cache_get(sector, false);
+    memcpy(buffer, e->data + ofs, size);
+    cache_put(e);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR starting at byte
+ * OFS.  The sector is only written back to disk when it is
+ * evicted or flushed.  A write that covers the whole sector does
+ * not read it from disk first. */
+void
+cache_write(block_sector_t sector, const void *buffer, size_t ofs,
+            size_t size)
+{
+    struct cache_entry *e;
+
+    ASSERT(ofs + size <= BLOCK_SECTOR_SIZE);
+
+    e = cache_get(sector, size == BLOCK_SECTOR_SIZE);
+    memcpy(e->data + ofs, buffer, size);
+    e->dirty = true;
+    cache_put(e);
+}
+
+/* Queues SECTOR to be read into the cache by the read-ahead
+ * thread and returns at once.  The request is dropped if the
+ * queue is full, since read-ahead is only a hint. */
+void
+cache_read_ahead(block_sector_t sector)
+{
+    lock_acquire(&ra_lock);
+    if (ra_cnt < READ_AHEAD_QUEUE) {
+        ra_queue[(ra_head + ra_cnt++) % READ_AHEAD_QUEUE] = sector;
+        cond_signal(&ra_queued, &ra_lock);
+    }
+    lock_release(&ra_lock);
+}
+
+/* Writes every dirty sector in the cache back to disk. */
+void
+cache_flush(void)
+{
+    size_t i;
+
+    for (i = 0; i < CACHE_SIZE; i++) {
+        struct cache_entry *e = &cache[i];
+
+        lock_acquire(&cache_lock);
+        if (e->sector == CACHE_NO_SECTOR) {
+            lock_release(&cache_lock);
+            continue;
+        }
+        e->pin_cnt++;
+        lock_release(&cache_lock);
+
+        lock_acquire(&e->lock);
+        if (e->dirty) {
+            block_write(fs_device, e->sector, e->data);
+            e->dirty = false;
+        }
+        cache_put(e);
+    }
+}
+
+/* Returns the entry for SECTOR, pinned and with its lock held,
+ * loading it into the cache if it is not already present.  If
+ * OVERWRITE is true the caller is about to replace the whole
+ * sector, so a missing sector is not read from disk. */
+static struct cache_entry *
+cache_get(block_sector_t sector, bool overwrite)
+{
+    struct cache_entry *e;
+    block_sector_t old_sector;
+    bool old_dirty;
+
+    ASSERT(sector != CACHE_NO_SECTOR);
+
+    lock_acquire(&cache_lock);
+    for (;;) {
+        e = cache_lookup(sector);
+        if (e != NULL) {
+            /* Hit.  If the entry is still being filled, its
+             * loader holds E->LOCK and we wait there. */
+            e->pin_cnt++;
+            e->accessed = true;
+            block_count_cache(fs_device, true);
+            lock_release(&cache_lock);
+            lock_acquire(&e->lock);
+            return e;
+        }
+
+        if (!cache_flushing(sector)) {
+            e = cache_evict();
+            if (e != NULL) {
+                break;
+            }
+        }
+
+        /* Every entry is pinned, or SECTOR's old contents are on
+         * their way to disk.  Wait and look again. */
+        cond_wait(&cache_changed, &cache_lock);
+    }
+
+    /* Miss.  Claim E for SECTOR before dropping cache_lock, so
+     * that other threads looking for SECTOR find it and block on
+     * E->LOCK until it has been filled in. */
+    lock_acquire(&e->lock);
+    old_sector = e->sector;
+    old_dirty = e->dirty;
+    e->sector = sector;
+    e->flushing = old_dirty ? old_sector : CACHE_NO_SECTOR;
+    e->pin_cnt = 1;
+    e->accessed = true;
+    block_count_cache(fs_device, false);
+    lock_release(&cache_lock);
+
+    if (old_dirty) {
+        block_write(fs_device, old_sector, e->data);
+        lock_acquire(&cache_lock);
+        e->flushing = CACHE_NO_SECTOR;
+        cond_broadcast(&cache_changed, &cache_lock);
+        lock_release(&cache_lock);
+    }
+
+    if (!overwrite) {
+        block_read(fs_device, sector, e->data);
+    }
+    e->dirty = false;
+    return e;
+}
+
+/* Releases E's lock and unpins it. */
+static void
+cache_put(struct cache_entry *e)
+{
+    lock_release(&e->lock);
+
+    lock_acquire(&cache_lock);
+    ASSERT(e->pin_cnt > 0);
+    if (--e->pin_cnt == 0) {
+        cond_broadcast(&cache_changed, &cache_lock);
+    }
+    lock_release(&cache_lock);
+}
+
+/* Returns the entry caching SECTOR, or a null pointer if there is
+ * none.  Must be called with cache_lock held. */
+static struct cache_entry *
+cache_lookup(block_sector_t sector)
+{
+    size_t i;
+
+    ASSERT(lock_held_by_current_thread(&cache_lock));
+
+    for (i = 0; i < CACHE_SIZE; i++) {
+        if (cache[i].sector == sector) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Returns true if an evicted copy of SECTOR is still being written
+ * back to disk, in which case reading SECTOR now would return
+ * stale data.  Must be called with cache_lock held. */
+static bool
+cache_flushing(block_sector_t sector)
+{
+    size_t i;
+
+    ASSERT(lock_held_by_current_thread(&cache_lock));
+
+    for (i = 0; i < CACHE_SIZE; i++) {
+        if (cache[i].flushing == sector) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Chooses an unpinned entry to reuse with the clock algorithm:
+ * entries accessed since the hand last passed get a second
+ * chance.  Returns a null pointer if every entry is pinned.
+ * Must be called with cache_lock held. */
+static struct cache_entry *
+cache_evict(void)
+{
+    size_t i;
+
+    ASSERT(lock_held_by_current_thread(&cache_lock));
+
+    for (i = 0; i < 2 * CACHE_SIZE; i++) {
+        struct cache_entry *e = &cache[clock_hand];
+        clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+        if (e->pin_cnt > 0) {
+            continue;
+        }
+        if (e->sector == CACHE_NO_SECTOR || !e->accessed) {
+            return e;
+        }
+        e->accessed = false;
+    }
+    return NULL;
+}
+
+/* Writes dirty sectors back to disk every CACHE_FLUSH_INTERVAL
+ * ticks, bounding how much a crash can lose. */
+static void
+flush_daemon(void *aux UNUSED)
+{
+    for (;;) {
+        timer_sleep(CACHE_FLUSH_INTERVAL);
+        cache_flush();
+    }
+}
+
+/* Serves cache_read_ahead() requests, loading each sector that
+ * is not already cached. */
+static void
+read_ahead_daemon(void *aux UNUSED)
+{
+    for (;;) {
+        block_sector_t sector;
+        bool cached;
+
+        lock_acquire(&ra_lock);
+        while (ra_cnt == 0) {
+            cond_wait(&ra_queued, &ra_lock);
+        }
+        sector = ra_queue[ra_head];
+        ra_head = (ra_head + 1) % READ_AHEAD_QUEUE;
+        ra_cnt--;
+        lock_release(&ra_lock);
+
+        lock_acquire(&cache_lock);
+        cached = cache_lookup(sector) != NULL;
+        lock_release(&cache_lock);
+        if (!cached) {
+            cache_put(cache_get(sector, false));
+        }
+    }
+}
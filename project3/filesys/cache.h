@@ -0,0 +1,18 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "devices/block.h"
+
+/* Number of sectors held in the buffer cache. */
+#define CACHE_SIZE 64
+
+void cache_init(void);
+void cache_read(block_sector_t, void *, size_t ofs, size_t size);
+void cache_write(block_sector_t, const void *, size_t ofs, size_t size);
+void cache_read_ahead(block_sector_t);
+void cache_flush(void);
+
+#endif /* filesys/cache.h */
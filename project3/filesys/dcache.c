@@ -0,0 +1,202 @@
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+
+#include "filesys/dcache.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Sector number recorded for a name known not to exist. */
+#define DCACHE_NEGATIVE ((block_sector_t) -1)
+
+/* A cached directory entry: NAME in the directory whose inode is
+ * in PARENT refers to the inode in SECTOR, or to nothing if
+ * SECTOR is DCACHE_NEGATIVE. */
+struct dentry {
+    struct hash_elem hash_elem;          /* Element in dentries. */
+    struct list_elem lru_elem;           /* Element in lru. */
+    block_sector_t   parent;             /* Directory's inode sector. */
+    char             name[NAME_MAX + 1]; /* Null terminated file name. */
+    block_sector_t   sector;             /* Inode sector or DCACHE_NEGATIVE. */
+};
+
+/* Cached entries, by parent and name, and in order of last use
+ * with the most recently used at the front.  Both are protected
+ * by dcache_lock.
+ *
+ * directory.c keeps the cache coherent: it only fills it in, and
+ * invalidates it, while holding the parent directory's dir_lock,
+ * so an entry never outlives the directory entry it mirrors. */
+static struct hash dentries;
+static struct list lru;
+static struct lock dcache_lock;
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static struct dentry *dentry_find(block_sector_t, const char *);
+static void dentry_discard(struct dentry *);
+
+/* Initializes the directory entry cache. */
+void
+dcache_init(void)
+{
+    lock_init(&dcache_lock);
+    list_init(&lru);
+    if (!hash_init(&dentries, dentry_hash, dentry_less, NULL)) {
+        PANIC("can't create directory entry cache");
+    }
+}
+
+/* Looks up NAME in the directory whose inode is in PARENT.
+ * Returns false if the cache knows nothing about NAME.
+ * Otherwise returns true and sets *INODE to NAME's inode, opened,
+ * or to a null pointer if NAME is known not to exist.  The inode
+ * is opened before the cache is unlocked, so a concurrent
+ * dir_remove() cannot free it first. */
+bool
+dcache_lookup(block_sector_t parent, const char *name,
+              struct inode **inode)
+{
+    struct dentry *d;
+
+    lock_acquire(&dcache_lock);
+    d = dentry_find(parent, name);
+    if (d != NULL) {
+        list_remove(&d->lru_elem);
+        list_push_front(&lru, &d->lru_elem);
+        *inode = d->sector != DCACHE_NEGATIVE ? inode_open(d->sector) : NULL;
+    }
+    lock_release(&dcache_lock);
+    return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in PARENT
+ * refers to INODE, or does not exist if INODE is null.  Evicts
+ * the least recently used entry if the cache is full.  Failure
+ * to allocate memory is not an error: the name just stays
+ * uncached. */
+void
+dcache_insert(block_sector_t parent, const char *name,
+              const struct inode *inode)
+{
+    block_sector_t sector = (inode != NULL ? inode_get_inumber(inode)
+                             : DCACHE_NEGATIVE);
+    struct dentry *d;
+
+    if (strlen(name) > NAME_MAX) {
+        return;
+    }
+
+    lock_acquire(&dcache_lock);
+    d = dentry_find(parent, name);
+    if (d != NULL) {
+        list_remove(&d->lru_elem);
+    } else {
+        if (hash_size(&dentries) >= DCACHE_SIZE) {
+            dentry_discard(list_entry(list_back(&lru), struct dentry,
+                                      lru_elem));
+        }
+        d = malloc(sizeof *d);
+        if (d == NULL) {
+            lock_release(&dcache_lock);
+            return;
+        }
+        d->parent = parent;
+        strlcpy(d->name, name, sizeof d->name);
+        hash_insert(&dentries, &d->hash_elem);
+    }
+    d->sector = sector;
+    list_push_front(&lru, &d->lru_elem);
+    lock_release(&dcache_lock);
+}
+
+/* Forgets whatever is cached about NAME in the directory whose
+ * inode is in PARENT. */
+void
+dcache_invalidate(block_sector_t parent, const char *name)
+{
+    struct dentry *d;
+
+    lock_acquire(&dcache_lock);
+    d = dentry_find(parent, name);
+    if (d != NULL) {
+        dentry_discard(d);
+    }
+    lock_release(&dcache_lock);
+}
+
+/* Forgets every name cached for the directory whose inode is in
+ * PARENT.  Called when that directory is removed, because its
+ * sector may be reused for another directory. */
+void
+dcache_purge(block_sector_t parent)
+{
+    struct list_elem *e;
+
+    lock_acquire(&dcache_lock);
+    for (e = list_begin(&lru); e != list_end(&lru);) {
+        struct dentry *d = list_entry(e, struct dentry, lru_elem);
+        e = list_next(e);
+        if (d->parent == parent) {
+            dentry_discard(d);
+        }
+    }
+    lock_release(&dcache_lock);
+}
+
+/* Returns the entry for NAME in PARENT, or a null pointer.
+ * Must be called with dcache_lock held. */
+static struct dentry *
+dentry_find(block_sector_t parent, const char *name)
+{
+    struct dentry key;
+    struct hash_elem *e;
+
+    ASSERT(lock_held_by_current_thread(&dcache_lock));
+
+    if (strlen(name) > NAME_MAX) {
+        return NULL;
+    }
+    key.parent = parent;
+    strlcpy(key.name, name, sizeof key.name);
+    e = hash_find(&dentries, &key.hash_elem);
+    return e != NULL ? hash_entry(e, struct dentry, hash_elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.
+ * Must be called with dcache_lock held. */
+static void
+dentry_discard(struct dentry *d)
+{
+    ASSERT(lock_held_by_current_thread(&dcache_lock));
+
+    hash_delete(&dentries, &d->hash_elem);
+    list_remove(&d->lru_elem);
+    free(d);
+}
+
+/* Hashes a cached entry by parent and name. */
+static unsigned
+dentry_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    const struct dentry *d = hash_entry(e, struct dentry, hash_elem);
+
+    return hash_string(d->name) ^ hash_int(d->parent);
+}
+
+/* Orders cached entries by parent, then name. */
+static bool
+dentry_less(const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+    const struct dentry *a = hash_entry(a_, struct dentry, hash_elem);
+    const struct dentry *b = hash_entry(b_, struct dentry, hash_elem);
+
+    if (a->parent != b->parent) {
+        return a->parent < b->parent;
+    }
+    return strcmp(a->name, b->name) < 0;
+}
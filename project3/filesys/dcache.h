@@ -0,0 +1,21 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+
+#include "devices/block.h"
+
+struct inode;
+
+/* Maximum number of names held in the directory entry cache. */
+#define DCACHE_SIZE 256
+
+void dcache_init(void);
+bool dcache_lookup(block_sector_t parent, const char *name,
+                   struct inode **);
+void dcache_insert(block_sector_t parent, const char *name,
+                   const struct inode *);
+void dcache_invalidate(block_sector_t parent, const char *name);
+void dcache_purge(block_sector_t parent);
+
+#endif /* filesys/dcache.h */
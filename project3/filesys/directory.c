@@ -1,18 +1,91 @@
+#include <hash.h>
 #include <list.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "filesys/dcache.h"
 #include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* In-memory name index of an open directory.
+ *
+ * Every struct dir open on the same directory shares one index,
+ * found through open_dirs, so that a lookup is a hash probe
+ * rather than a scan of the directory's entries on disk.  The
+ * index is read from disk the first time it is needed and freed
+ * when the last struct dir for the directory is closed.
+ *
+ * ELEM and OPEN_CNT are protected by open_dirs_lock, everything
+ * else by the directory inode's dir_lock. */
+struct dir_index {
+    struct hash_elem elem;       /* Element in open_dirs. */
+    block_sector_t   sector;     /* Directory's inode sector. */
+    int              open_cnt;   /* Number of struct dirs using this. */
+    bool             loaded;     /* Have NAMES been read from disk? */
+    struct hash      names;      /* struct dir_name, by name. */
+    struct list      free_slots; /* struct dir_slot, unused entries. */
+    off_t            end;        /* Offset just past the last entry. */
+};
+
+/* A name in a directory index. */
+struct dir_name {
+    struct hash_elem elem;               /* Element in names. */
+    char             name[NAME_MAX + 1]; /* Null terminated file name. */
+    block_sector_t   inode_sector;       /* Sector number of header. */
+    off_t            ofs;                /* Offset of the entry. */
+};
+
+/* An unused entry in a directory. */
+struct dir_slot {
+    struct list_elem elem;               /* Element in free_slots. */
+    off_t            ofs;                /* Offset of the entry. */
+};
+
+/* Indexes of open directories, by sector. */
+static struct hash open_dirs;
+static struct lock open_dirs_lock;
+
+static hash_hash_func dir_index_hash;
+static hash_less_func dir_index_less;
+static hash_hash_func dir_name_hash;
+static hash_less_func dir_name_less;
+static void dir_name_free(struct hash_elem *, void *aux);
+static bool index_load(struct dir *);
+static bool is_empty(struct inode *);
+
+/* Initializes the directory module. */
+void
+dir_init(void)
+{
+    lock_init(&open_dirs_lock);
+    if (!hash_init(&open_dirs, dir_index_hash, dir_index_less, NULL)) {
+        PANIC("can't create open directory table");
+    }
+}
 
 /* Creates a directory with space for ENTRY_CNT entries in the
- * given SECTOR.  Returns true if successful, false on failure. */
+ * given SECTOR, whose parent is the directory in PARENT_SECTOR.
+ * The new directory holds "." and ".." entries.
+ * Returns true if successful, false on failure. */
 bool
-dir_create(block_sector_t sector, size_t entry_cnt)
+dir_create(block_sector_t sector, size_t entry_cnt,
+           block_sector_t parent_sector)
 {
-    return inode_create(sector, entry_cnt * sizeof(struct dir_entry));
+    struct dir *dir;
+    bool success;
+
+    if (!inode_create(sector, entry_cnt * sizeof(struct dir_entry), true)) {
+        return false;
+    }
+    dir = dir_open(inode_open(sector));
+    success = (dir != NULL
+               && dir_add(dir, ".", sector)
+               && dir_add(dir, "..", parent_sector));
+    dir_close(dir);
+    return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -21,16 +94,46 @@ struct dir *
 dir_open(struct inode *inode)
 {
     struct dir *dir = calloc(1, sizeof *dir);
+    struct dir_index key;
+    struct hash_elem *e;
+
+    if (inode == NULL || dir == NULL) {
+        goto fail;
+    }
 
-    if (inode != NULL && dir != NULL) {
-        dir->inode = inode;
-        dir->pos = 0;
-        return dir;
+    dir->inode = inode;
+    dir->pos = 0;
+
+    /* Share the index of any other opener. */
+    key.sector = inode_get_inumber(inode);
+    lock_acquire(&open_dirs_lock);
+    e = hash_find(&open_dirs, &key.elem);
+    if (e != NULL) {
+        dir->index = hash_entry(e, struct dir_index, elem);
     } else {
-        inode_close(inode);
-        free(dir);
-        return NULL;
+        dir->index = malloc(sizeof *dir->index);
+        if (dir->index == NULL
+            || !hash_init(&dir->index->names, dir_name_hash, dir_name_less,
+                          NULL)) {
+            lock_release(&open_dirs_lock);
+            free(dir->index);
+            goto fail;
+        }
+        dir->index->sector = key.sector;
+        dir->index->open_cnt = 0;
+        dir->index->loaded = false;
+        list_init(&dir->index->free_slots);
+        dir->index->end = 0;
+        hash_insert(&open_dirs, &dir->index->elem);
     }
+    dir->index->open_cnt++;
+    lock_release(&open_dirs_lock);
+    return dir;
+
+fail:
+    inode_close(inode);
+    free(dir);
+    return NULL;
 }
 
 /* Opens the root directory and returns a directory for it.
@@ -49,14 +152,36 @@ dir_reopen(struct dir *dir)
     return dir_open(inode_reopen(dir->inode));
 }
 
-/* Destroys DIR and frees associated resources. */
+/* Destroys DIR and frees associated resources, including the
+ * directory's index if DIR was its last user. */
 void
 dir_close(struct dir *dir)
 {
-    if (dir != NULL) {
-        inode_close(dir->inode);
-        free(dir);
+    struct dir_index *index;
+
+    if (dir == NULL) {
+        return;
+    }
+
+    index = dir->index;
+    lock_acquire(&open_dirs_lock);
+    if (--index->open_cnt == 0) {
+        hash_delete(&open_dirs, &index->elem);
+    } else {
+        index = NULL;
+    }
+    lock_release(&open_dirs_lock);
+
+    if (index != NULL) {
+        hash_destroy(&index->names, dir_name_free);
+        while (!list_empty(&index->free_slots)) {
+            struct list_elem *e = list_pop_front(&index->free_slots);
+            free(list_entry(e, struct dir_slot, elem));
+        }
+        free(index);
     }
+    inode_close(dir->inode);
+    free(dir);
 }
 
 /* Returns the inode encapsulated by DIR. */
@@ -66,55 +191,62 @@ dir_get_inode(struct dir *dir)
     return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
- * If successful, returns true, sets *EP to the directory entry
- * if EP is non-null, and sets *OFSP to the byte offset of the
- * directory entry if OFSP is non-null.
- * otherwise, returns false and ignores EP and OFSP. */
-static bool
-lookup(const struct dir *dir, const char *name,
-       struct dir_entry *ep, off_t *ofsp)
+/* Returns the index entry for NAME in DIR, or a null pointer if
+ * there is none.  DIR's dir_lock must be held and its index
+ * loaded. */
+static struct dir_name *
+lookup(const struct dir *dir, const char *name)
 {
-    struct dir_entry e;
-    size_t ofs;
+    struct dir_name key;
+    struct hash_elem *e;
 
     ASSERT(dir != NULL);
     ASSERT(name != NULL);
+    ASSERT(lock_held_by_current_thread(&dir->inode->dir_lock));
+    ASSERT(dir->index->loaded);
 
-    for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
-         ofs += sizeof e) {
-        if (e.in_use && !strcmp(name, e.name)) {
-            if (ep != NULL) {
-                *ep = e;
-            }
-            if (ofsp != NULL) {
-                *ofsp = ofs;
-            }
-            return true;
-        }
+    if (strlen(name) > NAME_MAX) {
+        return NULL;
     }
-    return false;
+    strlcpy(key.name, name, sizeof key.name);
+    e = hash_find(&dir->index->names, &key.elem);
+    return e != NULL ? hash_entry(e, struct dir_name, elem) : NULL;
 }
 
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
- * a null pointer.  The caller must close *INODE. */
+ * a null pointer.  The caller must close *INODE.
+ * The answer, positive or negative, is remembered in the
+ * directory entry cache, which is consulted first. */
 bool
 dir_lookup(const struct dir *dir, const char *name,
            struct inode **inode)
 {
-    struct dir_entry e;
+    block_sector_t parent;
+    struct dir_name *n;
 
     ASSERT(dir != NULL);
     ASSERT(name != NULL);
 
-    if (lookup(dir, name, &e, NULL)) {
-        *inode = inode_open(e.inode_sector);
-    } else {
-        *inode = NULL;
+    parent = inode_get_inumber(dir->inode);
+    if (dcache_lookup(parent, name, inode)) {
+        return *inode != NULL;
     }
 
+    *inode = NULL;
+    lock_acquire(&dir->inode->dir_lock);
+    if (index_load((struct dir *) dir)) {
+        n = lookup(dir, name);
+        if (n != NULL) {
+            *inode = inode_open(n->inode_sector);
+        }
+        if (n == NULL || *inode != NULL) {
+            dcache_insert(parent, name, *inode);
+        }
+    }
+    lock_release(&dir->inode->dir_lock);
+
     return *inode != NULL;
 }
 
@@ -122,12 +254,14 @@ dir_lookup(const struct dir *dir, const char *name,
  * file by that name.  The file's inode is in sector
  * INODE_SECTOR.
  * Returns true if successful, false on failure.
- * Fails if NAME is invalid (i.e. too long) or a disk or memory
- * error occurs. */
+ * Fails if NAME is invalid (i.e. too long), if DIR has been
+ * removed, or if a disk or memory error occurs. */
 bool
 dir_add(struct dir *dir, const char *name, block_sector_t inode_sector)
 {
     struct dir_entry e;
+    struct dir_name *n = NULL;
+    struct dir_slot *slot = NULL;
     off_t ofs;
     bool success = false;
 
@@ -139,23 +273,30 @@ dir_add(struct dir *dir, const char *name, block_sector_t inode_sector)
         return false;
     }
 
+    /* DIR_LOCK is held until the new entry is written, so two
+     * creators cannot both claim NAME or the same free slot. */
+    lock_acquire(&dir->inode->dir_lock);
+    if (inode_is_removed(dir->inode) || !index_load(dir)) {
+        goto done;
+    }
+
     /* Check that NAME is not in use. */
-    if (lookup(dir, name, NULL, NULL)) {
+    if (lookup(dir, name) != NULL) {
         goto done;
     }
 
-    /* Set OFS to offset of free slot.
-     * If there are no free slots, then it will be set to the
-     * current end-of-file.
-     *
-     * inode_read_at() will only return a short read at end of file.
-     * Otherwise, we'd need to verify that we didn't get a short
-     * read due to something intermittent such as low memory. */
-    for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
-         ofs += sizeof e) {
-        if (!e.in_use) {
-            break;
-        }
+    n = malloc(sizeof *n);
+    if (n == NULL) {
+        goto done;
+    }
+
+    /* Reuse a free slot, or append at end of file. */
+    if (!list_empty(&dir->index->free_slots)) {
+        slot = list_entry(list_pop_front(&dir->index->free_slots),
+                          struct dir_slot, elem);
+        ofs = slot->ofs;
+    } else {
+        ofs = dir->index->end;
     }
 
     /* Write slot. */
@@ -164,53 +305,113 @@ dir_add(struct dir *dir, const char *name, block_sector_t inode_sector)
     e.inode_sector = inode_sector;
     success = inode_write_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
 
+    if (success) {
+        strlcpy(n->name, name, sizeof n->name);
+        n->inode_sector = inode_sector;
+        n->ofs = ofs;
+        hash_insert(&dir->index->names, &n->elem);
+        dcache_invalidate(inode_get_inumber(dir->inode), name);
+        if (ofs == dir->index->end) {
+            dir->index->end += sizeof e;
+        }
+        free(slot);
+        n = NULL;
+    } else if (slot != NULL) {
+        list_push_front(&dir->index->free_slots, &slot->elem);
+    }
+
 done:
+    lock_release(&dir->inode->dir_lock);
+    free(n);
     return success;
 }
 
 /* Removes any entry for NAME in DIR.
- * Returns true if successful, false on failure,
- * which occurs only if there is no file with the given NAME. */
+ * Returns true if successful, false on failure, which occurs if
+ * there is no file with the given NAME, if NAME is "." or "..",
+ * or if NAME is a directory that is not empty or that is open
+ * elsewhere (for example as some process's working directory). */
 bool
 dir_remove(struct dir *dir, const char *name)
 {
     struct dir_entry e;
+    struct dir_name *n;
+    struct dir_slot *slot = NULL;
     struct inode *inode = NULL;
+    bool is_dir = false;
     bool success = false;
-    off_t ofs;
 
     ASSERT(dir != NULL);
     ASSERT(name != NULL);
 
+    if (!strcmp(name, ".") || !strcmp(name, "..")) {
+        return false;
+    }
+
     /* Find directory entry. */
-    if (!lookup(dir, name, &e, &ofs)) {
+    lock_acquire(&dir->inode->dir_lock);
+    if (!index_load(dir) || (n = lookup(dir, name)) == NULL) {
+        goto done;
+    }
+
+    slot = malloc(sizeof *slot);
+    if (slot == NULL) {
         goto done;
     }
 
     /* Open inode. */
-    inode = inode_open(e.inode_sector);
+    inode = inode_open(n->inode_sector);
     if (inode == NULL) {
         goto done;
     }
 
+    /* A directory must be empty and otherwise unused.  Its
+     * dir_lock keeps anyone from adding to it until it is marked
+     * removed, after which dir_add() refuses. */
+    is_dir = inode_is_dir(inode);
+    if (is_dir) {
+        lock_acquire(&inode->dir_lock);
+        if (inode_open_cnt(inode) > 1 || !is_empty(inode)) {
+            goto done;
+        }
+    }
+
     /* Erase directory entry. */
-    e.in_use = false;
-    if (inode_write_at(dir->inode, &e, sizeof e, ofs) != sizeof e) {
+    memset(&e, 0, sizeof e);
+    if (inode_write_at(dir->inode, &e, sizeof e, n->ofs) != sizeof e) {
         goto done;
     }
+    slot->ofs = n->ofs;
+    list_push_front(&dir->index->free_slots, &slot->elem);
+    slot = NULL;
+    hash_delete(&dir->index->names, &n->elem);
+    free(n);
+
+    /* Drop cached names before the inode can be freed.  A removed
+     * directory's sector may be reused by another directory, so
+     * names cached under it must go too. */
+    dcache_invalidate(inode_get_inumber(dir->inode), name);
+    if (is_dir) {
+        dcache_purge(inode_get_inumber(inode));
+    }
 
     /* Remove inode. */
     inode_remove(inode);
     success = true;
 
 done:
+    if (is_dir) {
+        lock_release(&inode->dir_lock);
+    }
+    lock_release(&dir->inode->dir_lock);
+    free(slot);
     inode_close(inode);
     return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
  * NAME.  Returns true if successful, false if the directory
- * contains no more entries. */
+ * contains no more entries.  "." and ".." are skipped. */
 bool
 dir_readdir(struct dir *dir, char name[NAME_MAX + 1])
 {
@@ -218,10 +419,135 @@ dir_readdir(struct dir *dir, char name[NAME_MAX + 1])
 
     while (inode_read_at(dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
         dir->pos += sizeof e;
-        if (e.in_use) {
+        if (e.in_use && strcmp(e.name, ".") && strcmp(e.name, "..")) {
             strlcpy(name, e.name, NAME_MAX + 1);
             return true;
         }
     }
     return false;
 }
+
+/* Sets the position of the next dir_readdir() on DIR to POS,
+ * which must have been returned by dir_tell(). */
+void
+dir_seek(struct dir *dir, off_t pos)
+{
+    ASSERT(pos >= 0);
+    dir->pos = pos;
+}
+
+/* Returns the position of the next dir_readdir() on DIR. */
+off_t
+dir_tell(struct dir *dir)
+{
+    return dir->pos;
+}
+
+/* Reads DIR's entries into its index, if that has not been done
+ * yet.  Must be called with DIR's dir_lock held.
+ * Returns false if memory runs out. */
+static bool
+index_load(struct dir *dir)
+{
+    struct dir_index *index = dir->index;
+    struct dir_entry e;
+    off_t ofs;
+
+    ASSERT(lock_held_by_current_thread(&dir->inode->dir_lock));
+
+    if (index->loaded) {
+        return true;
+    }
+
+    /* inode_read_at() will only return a short read at end of
+     * file.  Otherwise, we'd need to verify that we didn't get a
+     * short read due to something intermittent such as low
+     * memory. */
+    for (ofs = 0; inode_read_at(dir->inode, &e, sizeof e, ofs) == sizeof e;
+         ofs += sizeof e) {
+        if (e.in_use) {
+            struct dir_name *n = malloc(sizeof *n);
+            if (n == NULL) {
+                goto fail;
+            }
+            strlcpy(n->name, e.name, sizeof n->name);
+            n->inode_sector = e.inode_sector;
+            n->ofs = ofs;
+            hash_insert(&index->names, &n->elem);
+        } else {
+            struct dir_slot *slot = malloc(sizeof *slot);
+            if (slot == NULL) {
+                goto fail;
+            }
+            slot->ofs = ofs;
+            list_push_back(&index->free_slots, &slot->elem);
+        }
+    }
+    index->end = ofs;
+    index->loaded = true;
+    return true;
+
+fail:
+    hash_clear(&index->names, dir_name_free);
+    while (!list_empty(&index->free_slots)) {
+        struct list_elem *le = list_pop_front(&index->free_slots);
+        free(list_entry(le, struct dir_slot, elem));
+    }
+    return false;
+}
+
+/* Returns true if directory INODE has no entries besides "." and
+ * "..". */
+static bool
+is_empty(struct inode *inode)
+{
+    struct dir_entry e;
+    off_t ofs;
+
+    for (ofs = 0; inode_read_at(inode, &e, sizeof e, ofs) == sizeof e;
+         ofs += sizeof e) {
+        if (e.in_use && strcmp(e.name, ".") && strcmp(e.name, "..")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Hashes a directory index by its sector. */
+static unsigned
+dir_index_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    return hash_int(hash_entry(e, struct dir_index, elem)->sector);
+}
+
+/* Orders directory indexes by sector. */
+static bool
+dir_index_less(const struct hash_elem *a, const struct hash_elem *b,
+               void *aux UNUSED)
+{
+    return hash_entry(a, struct dir_index, elem)->sector
+           < hash_entry(b, struct dir_index, elem)->sector;
+}
+
+/* Hashes a directory index entry by its name. */
+static unsigned
+dir_name_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    return hash_string(hash_entry(e, struct dir_name, elem)->name);
+}
+
+/* Orders directory index entries by name. */
+static bool
+dir_name_less(const struct hash_elem *a, const struct hash_elem *b,
+              void *aux UNUSED)
+{
+    return strcmp(hash_entry(a, struct dir_name, elem)->name,
+                  hash_entry(b, struct dir_name, elem)->name) < 0;
+}
+
+/* Frees a directory index entry. */
+static void
+dir_name_free(struct hash_elem *e, void *aux UNUSED)
+{
+    free(hash_entry(e, struct dir_name, elem));
+}
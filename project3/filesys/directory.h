@@ -13,10 +13,13 @@
  * retained, but much longer full path names must be allowed. */
 #define NAME_MAX 14
 
+struct dir_index;
+
 /* A directory. */
 struct dir {
-    struct inode *inode; /* Backing store. */
-    off_t         pos;   /* Current position. */
+    struct inode     *inode; /* Backing store. */
+    off_t             pos;   /* Current position. */
+    struct dir_index *index; /* Name index, shared with other openers. */
 };
 
 /* A single directory entry. */
@@ -27,7 +30,9 @@ struct dir_entry {
 };
 
 /* Opening and closing directories. */
-bool dir_create(block_sector_t sector, size_t entry_cnt);
+void dir_init(void);
+bool dir_create(block_sector_t sector, size_t entry_cnt,
+                block_sector_t parent_sector);
 struct dir *dir_open(struct inode *);
 struct dir *dir_open_root(void);
 struct dir *dir_reopen(struct dir *);
@@ -39,5 +44,7 @@ bool dir_lookup(const struct dir *, const char *name, struct inode **);
 bool dir_add(struct dir *, const char *name, block_sector_t);
 bool dir_remove(struct dir *, const char *name);
 bool dir_readdir(struct dir *, char name[NAME_MAX + 1]);
+void dir_seek(struct dir *, off_t);
+off_t dir_tell(struct dir *);
 
 #endif /* filesys/directory.h */
@@ -1,9 +1,16 @@
 #include <debug.h>
+#include <round.h>
 
 #include "filesys/file.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Bounds on the read-ahead window, in sectors. */
+#define RA_WINDOW_MIN 2
+#define RA_WINDOW_MAX 32
+
+static void file_read_ahead(struct file *, off_t ofs, off_t size);
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -16,6 +23,9 @@ file_open(struct inode *inode)
         file->inode = inode;
         file->pos = 0;
         file->deny_write = false;
+        file->ra_next = 0;
+        file->ra_end = 0;
+        file->ra_window = 0;
         return file;
     } else {
         inode_close(inode);
@@ -60,10 +70,54 @@ file_read(struct file *file, void *buffer, off_t size)
 {
     off_t bytes_read = inode_read_at(file->inode, buffer, size, file->pos);
 
+    file_read_ahead(file, file->pos, bytes_read);
     file->pos += bytes_read;
     return bytes_read;
 }
 
+/* Updates FILE's read-ahead state after a read of SIZE bytes at
+ * OFS and asks the buffer cache to start fetching the sectors
+ * that a sequential reader will want next.
+ *
+ * A read that starts where the previous one ended doubles the
+ * window, up to RA_WINDOW_MAX sectors; any other read turns
+ * read-ahead off until the access pattern looks sequential
+ * again.  Only sectors past the already prefetched range are
+ * requested, so each sector is prefetched at most once. */
+static void
+file_read_ahead(struct file *file, off_t ofs, off_t size)
+{
+    off_t start, end;
+
+    if (size == 0) {
+        return;
+    }
+
+    if (ofs == file->ra_next) {
+        file->ra_window = file->ra_window == 0 ? RA_WINDOW_MIN
+                          : file->ra_window * 2 > RA_WINDOW_MAX ? RA_WINDOW_MAX
+                          : file->ra_window * 2;
+    } else {
+        file->ra_window = 0;
+        file->ra_end = 0;
+    }
+    file->ra_next = ofs + size;
+
+    if (file->ra_window == 0) {
+        return;
+    }
+    start = ROUND_UP(file->ra_next, BLOCK_SECTOR_SIZE);
+    if (start < file->ra_end) {
+        start = file->ra_end;
+    }
+    end = ROUND_UP(file->ra_next, BLOCK_SECTOR_SIZE)
+          + file->ra_window * BLOCK_SECTOR_SIZE;
+    if (end > start) {
+        inode_read_ahead(file->inode, start, end - start);
+        file->ra_end = end;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually read,
@@ -76,11 +130,10 @@ file_read_at(struct file *file, void *buffer, off_t size, off_t file_ofs)
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
- * starting at the file's current position.
+ * starting at the file's current position, growing the file if
+ * the write extends past its end.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk fills up.
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write(struct file *file, const void *buffer, off_t size)
@@ -92,11 +145,10 @@ file_write(struct file *file, const void *buffer, off_t size)
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
- * starting at offset FILE_OFS in the file.
+ * starting at offset FILE_OFS in the file, growing the file if
+ * the write extends past its end.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk fills up.
  * The file's current position is unaffected. */
 off_t
 file_write_at(struct file *file, const void *buffer, off_t size,
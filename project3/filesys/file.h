@@ -9,6 +9,11 @@ struct file {
     struct inode *inode;      /* File's inode. */
     off_t         pos;        /* Current position. */
     bool          deny_write; /* Has file_deny_write() been called? */
+
+    /* Read-ahead state, see file_read_ahead(). */
+    off_t         ra_next;    /* Offset a sequential read would start at. */
+    off_t         ra_end;     /* End of the range already prefetched. */
+    int           ra_window;  /* Sectors to keep prefetched, 0 if off. */
 };
 
 /* Opening and closing files. */
@@ -2,16 +2,28 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* True between filesys_init() and filesys_done().  The kernel can
+ * power off before the file system, or even the thread system, is
+ * up, for example after "pintos -h", and there is then nothing to
+ * write back and no lock that can be taken. */
+static bool filesys_ready;
+
 static void do_format(void);
+static struct dir *open_cwd(void);
+static struct dir *resolve_parent(const char *path, char name[NAME_MAX + 1]);
+static void discard_inode(block_sector_t, bool created);
 
 /* Initializes the file system module.
  * If FORMAT is true, reformats the file system. */
@@ -23,7 +35,10 @@ filesys_init(bool format)
         PANIC("No file system device found, can't initialize file system.");
     }
 
+    cache_init();
     inode_init();
+    dir_init();
+    dcache_init();
     free_map_init();
 
     if (format) {
@@ -31,6 +46,7 @@ filesys_init(bool format)
     }
 
     free_map_open();
+    filesys_ready = true;
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -38,32 +54,103 @@ filesys_init(bool format)
 void
 filesys_done(void)
 {
+    if (!filesys_ready) {
+        return;
+    }
+    filesys_ready = false;
     free_map_close();
+    cache_flush();
+}
+
+/* Prints how fragmented the files in the root directory and the
+ * remaining free space are.  Must be called before
+ * filesys_done(). */
+void
+filesys_print_stats(void)
+{
+    char name[NAME_MAX + 1];
+    size_t files = 0, extents = 0;
+    struct dir *dir;
+
+    if (!filesys_ready) {
+        return;
+    }
+    dir = dir_open_root();
+    while (dir != NULL && dir_readdir(dir, name)) {
+        struct inode *inode;
+        if (dir_lookup(dir, name, &inode)) {
+            files++;
+            extents += inode_extent_cnt(inode);
+            inode_close(inode);
+        }
+    }
+    dir_close(dir);
+
+    if (files > 0) {
+        printf("Filesys: %zu files in %zu extents, %zu.%02zu extents per file\n",
+               files, extents, extents / files,
+               extents * 100 / files % 100);
+    }
+    free_map_print_stats();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
+ * NAME may be an absolute path or relative to the current
+ * thread's working directory.
  * Returns true if successful, false otherwise.
- * Fails if a file named NAME already exists,
- * or if internal memory allocation fails. */
+ * Fails if a file named NAME already exists, if a directory in
+ * NAME does not exist, or if internal memory allocation fails. */
 bool
 filesys_create(const char *name, off_t initial_size)
 {
+    char last[NAME_MAX + 1];
+    block_sector_t inode_sector = 0;
+    struct dir *dir = resolve_parent(name, last);
+    bool created = false;
+    bool success = (dir != NULL
+                    && free_map_allocate(1, &inode_sector)
+                    && (created = inode_create(inode_sector, initial_size,
+                                               false))
+                    && dir_add(dir, last, inode_sector));
+
+    if (!success && inode_sector != 0) {
+        discard_inode(inode_sector, created);
+    }
+    dir_close(dir);
+
+    return success;
+}
+
+/* Creates a directory named NAME, which may be an absolute path
+ * or relative to the current thread's working directory.
+ * Returns true if successful, false otherwise.
+ * Fails if NAME already exists, if a directory in NAME does not
+ * exist, or if internal memory allocation fails. */
+bool
+filesys_mkdir(const char *name)
+{
+    char last[NAME_MAX + 1];
     block_sector_t inode_sector = 0;
-    struct dir *dir = dir_open_root();
+    struct dir *dir = resolve_parent(name, last);
+    bool created = false;
     bool success = (dir != NULL
                     && free_map_allocate(1, &inode_sector)
-                    && inode_create(inode_sector, initial_size)
-                    && dir_add(dir, name, inode_sector));
+                    && (created = dir_create(inode_sector, 16,
+                                             inode_get_inumber(
+                                                 dir_get_inode(dir))))
+                    && dir_add(dir, last, inode_sector));
 
     if (!success && inode_sector != 0) {
-        free_map_release(inode_sector, 1);
+        discard_inode(inode_sector, created);
     }
     dir_close(dir);
 
     return success;
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file or directory with the given NAME, which may be
+ * an absolute path or relative to the current thread's working
+ * directory.
  * Returns the new file if successful or a null pointer
  * otherwise.
  * Fails if no file named NAME exists,
@@ -71,39 +158,160 @@ filesys_create(const char *name, off_t initial_size)
 struct file *
 filesys_open(const char *name)
 {
-    struct dir *dir = dir_open_root();
+    char last[NAME_MAX + 1];
+    struct dir *dir = resolve_parent(name, last);
     struct inode *inode = NULL;
 
     if (dir != NULL) {
-        dir_lookup(dir, name, &inode);
+        dir_lookup(dir, last, &inode);
     }
     dir_close(dir);
 
     return file_open(inode);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file or empty directory named NAME.
  * Returns true if successful, false on failure.
- * Fails if no file named NAME exists,
- * or if an internal memory allocation fails. */
+ * Fails if no file named NAME exists, if NAME is a directory
+ * that is not empty or is in use, or if an internal memory
+ * allocation fails. */
 bool
 filesys_remove(const char *name)
 {
-    struct dir *dir = dir_open_root();
-    bool success = dir != NULL && dir_remove(dir, name);
+    char last[NAME_MAX + 1];
+    struct dir *dir = resolve_parent(name, last);
+    bool success = dir != NULL && dir_remove(dir, last);
 
     dir_close(dir);
 
     return success;
 }
 
+/* Makes the directory named NAME the current thread's working
+ * directory.
+ * Returns true if successful, false if NAME does not exist or is
+ * not a directory. */
+bool
+filesys_chdir(const char *name)
+{
+    char last[NAME_MAX + 1];
+    struct thread *cur = thread_current();
+    struct dir *dir = resolve_parent(name, last);
+    struct inode *inode = NULL;
+
+    if (dir != NULL) {
+        dir_lookup(dir, last, &inode);
+    }
+    dir_close(dir);
+
+    if (inode == NULL || !inode_is_dir(inode)) {
+        inode_close(inode);
+        return false;
+    }
+    dir = dir_open(inode);
+    if (dir == NULL) {
+        return false;
+    }
+    dir_close(cur->cwd);
+    cur->cwd = dir;
+    return true;
+}
+
+/* Opens the current thread's working directory.  A thread that
+ * never changed directory works in the root. */
+static struct dir *
+open_cwd(void)
+{
+    struct dir *cwd = thread_current()->cwd;
+
+    return cwd != NULL ? dir_reopen(cwd) : dir_open_root();
+}
+
+/* Splits PATH into the directory holding its last component,
+ * which is returned opened, and that component, which is copied
+ * into NAME.  Relative paths start at the current thread's
+ * working directory, which is kept open, so resolving them does
+ * not walk down from the root again.  A path with no last
+ * component, such as "/", yields the directory itself with NAME
+ * set to ".".
+ * Returns a null pointer if PATH is empty, if a component is too
+ * long, or if a directory along the way does not exist. */
+static struct dir *
+resolve_parent(const char *path, char name[NAME_MAX + 1])
+{
+    struct dir *dir;
+
+    if (*path == '\0') {
+        return NULL;
+    }
+
+    dir = *path == '/' ? dir_open_root() : open_cwd();
+    strlcpy(name, ".", NAME_MAX + 1);
+    while (dir != NULL) {
+        char part[NAME_MAX + 1];
+        struct inode *inode;
+        size_t len;
+
+        while (*path == '/') {
+            path++;
+        }
+        if (*path == '\0') {
+            break;
+        }
+
+        len = strcspn(path, "/");
+        if (len > NAME_MAX) {
+            dir_close(dir);
+            return NULL;
+        }
+        memcpy(part, path, len);
+        part[len] = '\0';
+        path += len;
+        while (*path == '/') {
+            path++;
+        }
+
+        /* Last component: leave it for the caller. */
+        if (*path == '\0') {
+            strlcpy(name, part, NAME_MAX + 1);
+            break;
+        }
+
+        /* Descend into PART. */
+        if (!dir_lookup(dir, part, &inode) || !inode_is_dir(inode)) {
+            inode_close(inode);
+            dir_close(dir);
+            return NULL;
+        }
+        dir_close(dir);
+        dir = dir_open(inode);
+    }
+    return dir;
+}
+
+/* Frees the inode in SECTOR after a failed create.  If CREATED,
+ * the inode was written and owns data sectors that must go too. */
+static void
+discard_inode(block_sector_t sector, bool created)
+{
+    if (created) {
+        struct inode *inode = inode_open(sector);
+        if (inode != NULL) {
+            inode_remove(inode);
+            inode_close(inode);
+            return;
+        }
+    }
+    free_map_release(sector, 1);
+}
+
 /* Formats the file system. */
 static void
 do_format(void)
 {
     printf("Formatting file system...");
     free_map_create();
-    if (!dir_create(ROOT_DIR_SECTOR, 16)) {
+    if (!dir_create(ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR)) {
         PANIC("root directory creation failed");
     }
     free_map_close();
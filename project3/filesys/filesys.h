@@ -14,8 +14,11 @@ struct block *fs_device;
 
 void filesys_init(bool format);
 void filesys_done(void);
+void filesys_print_stats(void);
 bool filesys_create(const char *name, off_t initial_size);
 struct file *filesys_open(const char *name);
 bool filesys_remove(const char *name);
+bool filesys_mkdir(const char *name);
+bool filesys_chdir(const char *name);
 
 #endif /* filesys/filesys.h */
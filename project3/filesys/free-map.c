@@ -1,55 +1,488 @@
 #include <bitmap.h>
 #include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
 
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* A run of free sectors.
+ *
+ * Every maximal run of clear bits in the free map has exactly one
+ * extent.  by_start and by_end find the extent that begins or ends
+ * at a given sector, which is how allocation near a hint and
+ * merging neighbours on release look extents up.  by_size groups
+ * extents into buckets by size, for a quick good fit when there
+ * is no hint.  However fragmented the disk is, keeping them up to
+ * date takes constant time, and so does every lookup but the
+ * last-resort search of a single bucket in extent_fit(). */
+struct extent {
+    block_sector_t   start;      /* First free sector. */
+    size_t           cnt;        /* Number of free sectors. */
+    struct hash_elem start_elem; /* Element in by_start. */
+    struct hash_elem end_elem;   /* Element in by_end. */
+    struct list_elem size_elem;  /* Element in a by_size bucket. */
+};
+
+/* Number of by_size buckets.  Bucket I holds the extents of
+ * 2**I to 2**(I+1) - 1 sectors. */
+#define SIZE_BUCKETS 32
+
+/* How many sectors past a hint free_map_allocate_near() looks for
+ * free space before settling for any good fit. */
+#define NEAR_WINDOW 64
 
 static struct file *free_map_file; /* Free map file. */
 static struct bitmap *free_map;    /* Free map, one bit per sector. */
+static bool free_map_dirty;        /* FREE_MAP differs from its file. */
+static struct hash by_start;       /* Free extents by start sector. */
+static struct hash by_end;         /* Free extents by end sector. */
+static struct list by_size[SIZE_BUCKETS]; /* Free extents by size. */
+static struct lock free_map_lock;  /* Guards everything above. */
+
+static void build_extents(void);
+static void take_sectors(struct extent *, block_sector_t, size_t);
+static void extent_insert(struct extent *);
+static void extent_remove(struct extent *);
+static struct extent *extent_at(block_sector_t start);
+static struct extent *extent_ending_at(block_sector_t end);
+static struct extent *extent_near(block_sector_t hint);
+static struct extent *extent_fit(size_t cnt);
+static struct extent *extent_big(void);
+static size_t size_bucket(size_t cnt);
+static hash_hash_func extent_start_hash;
+static hash_less_func extent_start_less;
+static hash_hash_func extent_end_hash;
+static hash_less_func extent_end_less;
 
 /* Initializes the free map. */
 void
 free_map_init(void)
 {
+    size_t i;
+
+    lock_init(&free_map_lock);
+    if (!hash_init(&by_start, extent_start_hash, extent_start_less, NULL)
+        || !hash_init(&by_end, extent_end_hash, extent_end_less, NULL)) {
+        PANIC("can't create free extent index");
+    }
+    for (i = 0; i < SIZE_BUCKETS; i++) {
+        list_init(&by_size[i]);
+    }
     free_map = bitmap_create(block_size(fs_device));
     if (free_map == NULL) {
         PANIC("bitmap creation failed--file system device is too large");
     }
     bitmap_mark(free_map, FREE_MAP_SECTOR);
     bitmap_mark(free_map, ROOT_DIR_SECTOR);
+    build_extents();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
- * the first into *SECTORP.
+ * the first into *SECTORP.  Picks a small free extent that is
+ * large enough, to keep large extents for large files.
  * Returns true if successful, false if not enough consecutive
- * sectors were available or if the free_map file could not be
- * written. */
+ * sectors were available. */
 bool
 free_map_allocate(size_t cnt, block_sector_t *sectorp)
 {
-    block_sector_t sector = bitmap_scan_and_flip(free_map, 0, cnt, false);
+    struct extent *x;
+
+    lock_acquire(&free_map_lock);
+    x = extent_fit(cnt);
+    if (x != NULL) {
+        *sectorp = x->start;
+        take_sectors(x, x->start, cnt);
+    }
+    lock_release(&free_map_lock);
+    return x != NULL;
+}
+
+/* Allocates between 1 and MAX_CNT consecutive sectors, as close
+ * after sector HINT as possible, and stores the first into
+ * *SECTORP.  Callers growing a file pass the sector just past its
+ * last one, so that the file stays contiguous on disk when it can.
+ * Returns the number of sectors allocated, or 0 if the disk is
+ * full. */
+size_t
+free_map_allocate_near(size_t max_cnt, block_sector_t hint,
+                       block_sector_t *sectorp)
+{
+    struct extent *x;
+    block_sector_t start;
+    size_t cnt;
+
+    ASSERT(max_cnt > 0);
+
+    lock_acquire(&free_map_lock);
+    x = extent_near(hint);
 
-    if (sector != BITMAP_ERROR
-        && free_map_file != NULL
-        && !bitmap_write(free_map, free_map_file)) {
-        bitmap_set_multiple(free_map, sector, cnt, false);
-        sector = BITMAP_ERROR;
+    /* Nothing close after HINT: settle for a good fit, or for a
+     * big extent if none is big enough. */
+    if (x == NULL) {
+        x = extent_fit(max_cnt);
     }
-    if (sector != BITMAP_ERROR) {
-        *sectorp = sector;
+    if (x == NULL) {
+        x = extent_big();
     }
-    return sector != BITMAP_ERROR;
+
+    if (x == NULL) {
+        lock_release(&free_map_lock);
+        return 0;
+    }
+
+    start = hint > x->start && hint < x->start + x->cnt ? hint : x->start;
+    cnt = x->start + x->cnt - start;
+    if (cnt > max_cnt) {
+        cnt = max_cnt;
+    }
+    take_sectors(x, start, cnt);
+    lock_release(&free_map_lock);
+
+    *sectorp = start;
+    return cnt;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use,
+ * merging them with the free extents on either side. */
 void
 free_map_release(block_sector_t sector, size_t cnt)
 {
+    struct extent *prev, *next;
+
+    lock_acquire(&free_map_lock);
     ASSERT(bitmap_all(free_map, sector, cnt));
     bitmap_set_multiple(free_map, sector, cnt, false);
-    bitmap_write(free_map, free_map_file);
+    free_map_dirty = true;
+
+    prev = extent_ending_at(sector);
+    next = extent_at(sector + cnt);
+    if (prev != NULL) {
+        /* Grow PREV, absorbing NEXT too if the gap is now closed. */
+        extent_remove(prev);
+        prev->cnt += cnt;
+        if (next != NULL) {
+            extent_remove(next);
+            prev->cnt += next->cnt;
+            free(next);
+        }
+        extent_insert(prev);
+    } else if (next != NULL) {
+        extent_remove(next);
+        next->start = sector;
+        next->cnt += cnt;
+        extent_insert(next);
+    } else {
+        struct extent *x = malloc(sizeof *x);
+        if (x == NULL) {
+            PANIC("out of memory for free map extents");
+        }
+        x->start = sector;
+        x->cnt = cnt;
+        extent_insert(x);
+    }
+    lock_release(&free_map_lock);
+}
+
+/* Writes the free map to its file if it has changed since the
+ * last write.  Allocation and release only update the in-memory
+ * bitmap, so callers that change many sectors at once pay for a
+ * single write here. */
+void
+free_map_flush(void)
+{
+    lock_acquire(&free_map_lock);
+    if (free_map_dirty && free_map_file != NULL) {
+        if (!bitmap_write(free_map, free_map_file)) {
+            PANIC("can't write free map");
+        }
+        free_map_dirty = false;
+    }
+    lock_release(&free_map_lock);
+}
+
+/* Prints the number of free extents and the size of the largest
+ * one, a measure of how fragmented free space is. */
+void
+free_map_print_stats(void)
+{
+    size_t largest = 0;
+    int i;
+
+    lock_acquire(&free_map_lock);
+    for (i = SIZE_BUCKETS - 1; i >= 0 && largest == 0; i--) {
+        struct list_elem *e;
+
+        for (e = list_begin(&by_size[i]); e != list_end(&by_size[i]);
+             e = list_next(e)) {
+            struct extent *x = list_entry(e, struct extent, size_elem);
+            if (x->cnt > largest) {
+                largest = x->cnt;
+            }
+        }
+    }
+    printf("Free map: %zu free extents, largest %zu sectors\n",
+           hash_size(&by_start), largest);
+    lock_release(&free_map_lock);
+}
+
+/* Marks CNT sectors starting at START, which must lie inside free
+ * extent X, as allocated, shrinking or splitting X.
+ * Must be called with free_map_lock held. */
+static void
+take_sectors(struct extent *x, block_sector_t start, size_t cnt)
+{
+    block_sector_t end = start + cnt;
+    block_sector_t x_end = x->start + x->cnt;
+
+    ASSERT(lock_held_by_current_thread(&free_map_lock));
+    ASSERT(start >= x->start && end <= x_end);
+    ASSERT(!bitmap_any(free_map, start, cnt));
+
+    bitmap_set_multiple(free_map, start, cnt, true);
+    free_map_dirty = true;
+
+    extent_remove(x);
+    if (start == x->start && end == x_end) {
+        free(x);
+        return;
+    }
+
+    if (start > x->start && end < x_end) {
+        /* Split: X keeps the part before, a new extent the part
+         * after. */
+        struct extent *y = malloc(sizeof *y);
+        if (y == NULL) {
+            PANIC("out of memory for free map extents");
+        }
+        y->start = end;
+        y->cnt = x_end - end;
+        extent_insert(y);
+        x->cnt = start - x->start;
+    } else if (start == x->start) {
+        x->start = end;
+        x->cnt = x_end - end;
+    } else {
+        x->cnt = start - x->start;
+    }
+    extent_insert(x);
+}
+
+/* Adds X to the indexes. */
+static void
+extent_insert(struct extent *x)
+{
+    hash_insert(&by_start, &x->start_elem);
+    hash_insert(&by_end, &x->end_elem);
+    list_push_front(&by_size[size_bucket(x->cnt)], &x->size_elem);
+}
+
+/* Removes X from the indexes, before it changes or is freed. */
+static void
+extent_remove(struct extent *x)
+{
+    hash_delete(&by_start, &x->start_elem);
+    hash_delete(&by_end, &x->end_elem);
+    list_remove(&x->size_elem);
+}
+
+/* Returns the free extent that begins at sector START, or a null
+ * pointer if there is none. */
+static struct extent *
+extent_at(block_sector_t start)
+{
+    struct extent key;
+    struct hash_elem *e;
+
+    key.start = start;
+    e = hash_find(&by_start, &key.start_elem);
+    return e != NULL ? hash_entry(e, struct extent, start_elem) : NULL;
+}
+
+/* Returns the free extent whose last sector is just before END,
+ * or a null pointer if there is none. */
+static struct extent *
+extent_ending_at(block_sector_t end)
+{
+    struct extent key;
+    struct hash_elem *e;
+
+    key.start = end;
+    key.cnt = 0;
+    e = hash_find(&by_end, &key.end_elem);
+    return e != NULL ? hash_entry(e, struct extent, end_elem) : NULL;
+}
+
+/* Returns the free extent that contains sector HINT or begins
+ * within NEAR_WINDOW sectors after it, or a null pointer if there
+ * is none.  Only the first free sector found can lie inside an
+ * extent rather than at its start, and only if it is HINT: every
+ * later one follows a sector in use. */
+static struct extent *
+extent_near(block_sector_t hint)
+{
+    size_t size = bitmap_size(free_map);
+    block_sector_t s;
+
+    for (s = hint; s < size && s - hint < NEAR_WINDOW; s++) {
+        if (!bitmap_test(free_map, s)) {
+            while (s > 0 && !bitmap_test(free_map, s - 1)) {
+                s--;
+            }
+            return extent_at(s);
+        }
+    }
+    return NULL;
+}
+
+/* Returns a free extent of at least CNT sectors, or a null
+ * pointer if there is none.  Prefers the smallest bucket whose
+ * every extent is big enough, which finds one in constant time
+ * and is within a factor of two of the best fit, and only then
+ * searches CNT's own bucket. */
+static struct extent *
+extent_fit(size_t cnt)
+{
+    size_t b = size_bucket(cnt);
+    size_t i = cnt == (size_t) 1 << b ? b : b + 1;
+    struct list_elem *e;
+
+    for (; i < SIZE_BUCKETS; i++) {
+        if (!list_empty(&by_size[i])) {
+            return list_entry(list_front(&by_size[i]), struct extent,
+                              size_elem);
+        }
+    }
+    for (e = list_begin(&by_size[b]); e != list_end(&by_size[b]);
+         e = list_next(e)) {
+        struct extent *x = list_entry(e, struct extent, size_elem);
+        if (x->cnt >= cnt) {
+            return x;
+        }
+    }
+    return NULL;
+}
+
+/* Returns a free extent from the bucket of the largest ones, which
+ * is at least half as big as the largest, or a null pointer if
+ * the disk is full. */
+static struct extent *
+extent_big(void)
+{
+    int i;
+
+    for (i = SIZE_BUCKETS - 1; i >= 0; i--) {
+        if (!list_empty(&by_size[i])) {
+            return list_entry(list_front(&by_size[i]), struct extent,
+                              size_elem);
+        }
+    }
+    return NULL;
+}
+
+/* Returns the by_size bucket for an extent of CNT sectors, the
+ * index of the highest bit set in CNT. */
+static size_t
+size_bucket(size_t cnt)
+{
+    size_t b = 0;
+
+    ASSERT(cnt > 0);
+
+    while (cnt >>= 1) {
+        b++;
+    }
+    return b < SIZE_BUCKETS ? b : SIZE_BUCKETS - 1;
+}
+
+/* Returns a hash value for the start sector of the extent that E
+ * refers to. */
+static unsigned
+extent_start_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    return hash_int(hash_entry(e, struct extent, start_elem)->start);
+}
+
+/* Returns true if extent A starts before extent B. */
+static bool
+extent_start_less(const struct hash_elem *a_, const struct hash_elem *b_,
+                  void *aux UNUSED)
+{
+    const struct extent *a = hash_entry(a_, struct extent, start_elem);
+    const struct extent *b = hash_entry(b_, struct extent, start_elem);
+
+    return a->start < b->start;
+}
+
+/* Returns a hash value for the sector just past the extent that E
+ * refers to. */
+static unsigned
+extent_end_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    const struct extent *x = hash_entry(e, struct extent, end_elem);
+    return hash_int(x->start + x->cnt);
+}
+
+/* Returns true if extent A ends before extent B. */
+static bool
+extent_end_less(const struct hash_elem *a_, const struct hash_elem *b_,
+                void *aux UNUSED)
+{
+    const struct extent *a = hash_entry(a_, struct extent, end_elem);
+    const struct extent *b = hash_entry(b_, struct extent, end_elem);
+
+    return a->start + a->cnt < b->start + b->cnt;
+}
+
+/* Frees the extent that E, an element of by_start, refers to. */
+static void
+extent_free(struct hash_elem *e, void *aux UNUSED)
+{
+    free(hash_entry(e, struct extent, start_elem));
+}
+
+/* Discards the extent indexes and rebuilds them from the
+ * bitmap. */
+static void
+build_extents(void)
+{
+    size_t size = bitmap_size(free_map);
+    size_t start = 0;
+    size_t i;
+
+    hash_clear(&by_end, NULL);
+    hash_clear(&by_start, extent_free);
+    for (i = 0; i < SIZE_BUCKETS; i++) {
+        list_init(&by_size[i]);
+    }
+
+    for (;;) {
+        struct extent *x;
+        size_t end;
+
+        start = bitmap_scan(free_map, start, 1, false);
+        if (start == BITMAP_ERROR) {
+            break;
+        }
+        end = bitmap_scan(free_map, start, 1, true);
+        if (end == BITMAP_ERROR) {
+            end = size;
+        }
+
+        x = malloc(sizeof *x);
+        if (x == NULL) {
+            PANIC("out of memory for free map extents");
+        }
+        x->start = start;
+        x->cnt = end - start;
+        extent_insert(x);
+        start = end;
+    }
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -63,13 +496,16 @@ free_map_open(void)
     if (!bitmap_read(free_map, free_map_file)) {
         PANIC("can't read free map");
     }
+    build_extents();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close(void)
 {
+    free_map_flush();
     file_close(free_map_file);
+    free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -78,7 +514,7 @@ void
 free_map_create(void)
 {
     /* Create inode. */
-    if (!inode_create(FREE_MAP_SECTOR, bitmap_file_size(free_map))) {
+    if (!inode_create(FREE_MAP_SECTOR, bitmap_file_size(free_map), false)) {
         PANIC("free map creation failed");
     }
 
@@ -90,4 +526,5 @@ free_map_create(void)
     if (!bitmap_write(free_map, free_map_file)) {
         PANIC("can't write free map");
     }
+    free_map_dirty = false;
 }
@@ -12,6 +12,10 @@ void free_map_create(void);
 void free_map_open(void);
 void free_map_close(void);
 bool free_map_allocate(size_t, block_sector_t *);
+size_t free_map_allocate_near(size_t max_cnt, block_sector_t hint,
+                              block_sector_t *);
 void free_map_release(block_sector_t, size_t);
+void free_map_flush(void);
+void free_map_print_stats(void);
 
 #endif /* filesys/free-map.h */
@@ -2,6 +2,7 @@
 #include <round.h>
 #include <string.h>
 
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
@@ -18,39 +19,287 @@ bytes_to_sectors(off_t size)
     return DIV_ROUND_UP(size, BLOCK_SECTOR_SIZE);
 }
 
+/* Returns the number of the index block ("leaf") that maps data
+ * sector IDX, which must be past the direct pointers, and stores
+ * IDX's position within that block into *OFS.  Leaf 0 is the
+ * single-indirect block and leaf 1 + N is the Nth block under the
+ * doubly-indirect block. */
+static int
+index_leaf(size_t idx, size_t *ofs)
+{
+    ASSERT(idx >= INODE_DIRECT_CNT);
+
+    idx -= INODE_DIRECT_CNT;
+    *ofs = idx % INODE_PTRS_PER_SECTOR;
+    return idx / INODE_PTRS_PER_SECTOR;
+}
+
+/* Returns the sector of leaf index block LEAF of DISK, or 0 if it
+ * has not been allocated. */
+static block_sector_t
+leaf_sector(const struct inode_disk *disk, int leaf)
+{
+    block_sector_t sector;
+
+    if (leaf == 0) {
+        return disk->indirect;
+    }
+    if (disk->doubly_indirect == 0) {
+        return 0;
+    }
+    cache_read(disk->doubly_indirect, &sector, (leaf - 1) * sizeof sector,
+               sizeof sector);
+    return sector;
+}
+
 /* Returns the block device sector that contains byte offset POS
  * within INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
- * POS. */
+ * POS.
+ * Indirect lookups go through INODE's copy of the index block it
+ * used last, so a sequential scan reads each index block from the
+ * buffer cache once. */
 static block_sector_t
-byte_to_sector(const struct inode *inode, off_t pos)
+byte_to_sector(struct inode *inode, off_t pos)
 {
+    size_t idx, ofs;
+    block_sector_t sector;
+    int leaf;
+
     ASSERT(inode != NULL);
-    if (pos < inode->data.length) {
-        return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-    } else {
+    if (pos >= inode->data.length) {
         return -1;
     }
+
+    idx = pos / BLOCK_SECTOR_SIZE;
+    if (idx < INODE_DIRECT_CNT) {
+        return inode->data.direct[idx];
+    }
+
+    leaf = index_leaf(idx, &ofs);
+    lock_acquire(&inode->index_lock);
+    if (inode->index_leaf != leaf) {
+        cache_read(leaf_sector(&inode->data, leaf), inode->index, 0,
+                   BLOCK_SECTOR_SIZE);
+        inode->index_leaf = leaf;
+    }
+    sector = inode->index[ofs];
+    lock_release(&inode->index_lock);
+    return sector;
+}
+
+/* Returns the sector holding data sector IDX of DISK, reading
+ * index blocks through the buffer cache. */
+static block_sector_t
+disk_sector(const struct inode_disk *disk, size_t idx)
+{
+    block_sector_t sector;
+    size_t ofs;
+    int leaf;
+
+    if (idx < INODE_DIRECT_CNT) {
+        return disk->direct[idx];
+    }
+    leaf = index_leaf(idx, &ofs);
+    cache_read(leaf_sector(disk, leaf), &sector, ofs * sizeof sector,
+               sizeof sector);
+    return sector;
+}
+
+/* Sectors that inode_extend() has taken from the free map but not
+ * yet handed out.  Taking whole extents at a time keeps a growing
+ * file contiguous on disk. */
+struct sector_run {
+    block_sector_t next;        /* Next sector to hand out. */
+    size_t         cnt;         /* Number of sectors left in the run. */
+    size_t         want;        /* Sectors the extension still needs. */
+};
+
+/* If *SECTORP is 0, takes a sector from RUN, refilling RUN from
+ * the free map near its end if it is empty, fills the sector with
+ * zeros and stores its number in *SECTORP.
+ * Returns false if the disk is full. */
+static bool
+allocate_zeroed(block_sector_t *sectorp, struct sector_run *run)
+{
+    static char zeros[BLOCK_SECTOR_SIZE];
+
+    if (*sectorp != 0) {
+        return true;
+    }
+    if (run->cnt == 0) {
+        run->cnt = free_map_allocate_near(run->want > 0 ? run->want : 1,
+                                          run->next, &run->next);
+        if (run->cnt == 0) {
+            return false;
+        }
+    }
+    *sectorp = run->next++;
+    run->cnt--;
+    if (run->want > 0) {
+        run->want--;
+    }
+    cache_write(*sectorp, zeros, 0, BLOCK_SECTOR_SIZE);
+    return true;
+}
+
+/* Makes sure entry OFS of index block INDEX_SECTOR points to an
+ * allocated sector, taking one from RUN if necessary.  Stores the
+ * entry into *SECTORP.
+ * Returns false if the disk is full. */
+static bool
+allocate_entry(block_sector_t index_sector, size_t ofs,
+               block_sector_t *sectorp, struct sector_run *run)
+{
+    cache_read(index_sector, sectorp, ofs * sizeof *sectorp,
+               sizeof *sectorp);
+    if (*sectorp == 0) {
+        if (!allocate_zeroed(sectorp, run)) {
+            return false;
+        }
+        cache_write(index_sector, sectorp, ofs * sizeof *sectorp,
+                    sizeof *sectorp);
+    }
+    return true;
+}
+
+/* Allocates data sector IDX of DISK, and any index blocks needed
+ * to reach it, from RUN unless they already exist.
+ * Returns false if the disk is full. */
+static bool
+allocate_sector(struct inode_disk *disk, size_t idx, struct sector_run *run)
+{
+    block_sector_t leaf_sector, data_sector;
+    size_t ofs;
+    int leaf;
+
+    if (idx < INODE_DIRECT_CNT) {
+        return allocate_zeroed(&disk->direct[idx], run);
+    }
+
+    leaf = index_leaf(idx, &ofs);
+    if (leaf == 0) {
+        if (!allocate_zeroed(&disk->indirect, run)) {
+            return false;
+        }
+        leaf_sector = disk->indirect;
+    } else if (!allocate_zeroed(&disk->doubly_indirect, run)
+               || !allocate_entry(disk->doubly_indirect, leaf - 1,
+                                  &leaf_sector, run)) {
+        return false;
+    }
+    return allocate_entry(leaf_sector, ofs, &data_sector, run);
+}
+
+/* Grows DISK, the inode stored in SECTOR, to LENGTH bytes,
+ * allocating zeroed sectors for the new data.  New sectors are
+ * placed right after the file's current last sector, or after
+ * the inode itself for an empty file, whenever that space is
+ * free.  If the disk fills up, grows DISK only as far as the
+ * sectors that could be allocated.
+ * Returns true if DISK reached LENGTH. */
+static bool
+inode_extend(struct inode_disk *disk, block_sector_t sector, off_t length)
+{
+    size_t old_sectors = bytes_to_sectors(disk->length);
+    size_t new_sectors = bytes_to_sectors(length);
+    struct sector_run run;
+    bool success = true;
+    size_t idx;
+
+    ASSERT(length <= INODE_MAX_LENGTH);
+
+    run.next = (old_sectors > 0 ? disk_sector(disk, old_sectors - 1)
+                : sector) + 1;
+    run.cnt = 0;
+    run.want = new_sectors > old_sectors ? new_sectors - old_sectors : 0;
+
+    for (idx = old_sectors; idx < new_sectors; idx++) {
+        if (!allocate_sector(disk, idx, &run)) {
+            success = false;
+            length = idx * BLOCK_SECTOR_SIZE;
+            break;
+        }
+    }
+    if (length > disk->length) {
+        disk->length = length;
+    }
+
+    /* Return whatever is left of the last extent, then write the
+     * free map once for the whole extension. */
+    if (run.cnt > 0) {
+        free_map_release(run.next, run.cnt);
+    }
+    free_map_flush();
+    return success;
+}
+
+/* Releases index block SECTOR and everything it points to.
+ * LEVEL is 1 for a block of data pointers, 2 for a block of
+ * pointers to such blocks. */
+static void
+release_index(block_sector_t sector, int level)
+{
+    block_sector_t ptrs[INODE_PTRS_PER_SECTOR];
+    size_t i;
+
+    cache_read(sector, ptrs, 0, BLOCK_SECTOR_SIZE);
+    for (i = 0; i < INODE_PTRS_PER_SECTOR; i++) {
+        if (ptrs[i] == 0) {
+            continue;
+        }
+        if (level > 1) {
+            release_index(ptrs[i], level - 1);
+        } else {
+            free_map_release(ptrs[i], 1);
+        }
+    }
+    free_map_release(sector, 1);
+}
+
+/* Releases every data and index sector allocated to DISK,
+ * including any left past its length by a failed extension. */
+static void
+inode_deallocate(struct inode_disk *disk)
+{
+    size_t i;
+
+    for (i = 0; i < INODE_DIRECT_CNT; i++) {
+        if (disk->direct[i] != 0) {
+            free_map_release(disk->direct[i], 1);
+        }
+    }
+    if (disk->indirect != 0) {
+        release_index(disk->indirect, 1);
+    }
+    if (disk->doubly_indirect != 0) {
+        release_index(disk->doubly_indirect, 2);
+    }
+    free_map_flush();
 }
 
 /* List of open inodes, so that opening a single inode twice
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes and each inode's open_cnt and removed. */
+static struct lock open_inodes_lock;
+
 /* Initializes the inode module. */
 void
 inode_init(void)
 {
     list_init(&open_inodes);
+    lock_init(&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
  * writes the new inode to sector SECTOR on the file system
- * device.
+ * device.  IS_DIR marks the inode as a directory.
  * Returns true if successful.
  * Returns false if memory or disk allocation fails. */
 bool
-inode_create(block_sector_t sector, off_t length)
+inode_create(block_sector_t sector, off_t length, bool is_dir)
 {
     struct inode_disk *disk_inode = NULL;
     bool success = false;
@@ -61,22 +310,20 @@ inode_create(block_sector_t sector, off_t length)
      * one sector in size, and you should fix that. */
     ASSERT(sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+    if (length > INODE_MAX_LENGTH) {
+        return false;
+    }
+
     disk_inode = calloc(1, sizeof *disk_inode);
     if (disk_inode != NULL) {
-        size_t sectors = bytes_to_sectors(length);
-        disk_inode->length = length;
+        disk_inode->length = 0;
         disk_inode->magic = INODE_MAGIC;
-        if (free_map_allocate(sectors, &disk_inode->start)) {
-            block_write(fs_device, sector, disk_inode);
-            if (sectors > 0) {
-                static char zeros[BLOCK_SECTOR_SIZE];
-                size_t i;
-
-                for (i = 0; i < sectors; i++) {
-                    block_write(fs_device, disk_inode->start + i, zeros);
-                }
-            }
+        disk_inode->is_dir = is_dir;
+        if (inode_extend(disk_inode, sector, length)) {
+            cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
             success = true;
+        } else {
+            inode_deallocate(disk_inode);
         }
         free(disk_inode);
     }
@@ -92,12 +339,15 @@ inode_open(block_sector_t sector)
     struct list_elem *e;
     struct inode *inode;
 
+    lock_acquire(&open_inodes_lock);
+
     /* Check whether this inode is already open. */
     for (e = list_begin(&open_inodes); e != list_end(&open_inodes);
          e = list_next(e)) {
         inode = list_entry(e, struct inode, elem);
         if (inode->sector == sector) {
-            inode_reopen(inode);
+            inode->open_cnt++;
+            lock_release(&open_inodes_lock);
             return inode;
         }
     }
@@ -105,16 +355,23 @@ inode_open(block_sector_t sector)
     /* Allocate memory. */
     inode = malloc(sizeof *inode);
     if (inode == NULL) {
+        lock_release(&open_inodes_lock);
         return NULL;
     }
 
-    /* Initialize. */
+    /* Initialize.  The disk read happens with the list locked so
+     * that a second opener cannot see a half-initialized inode. */
     list_push_front(&open_inodes, &inode->elem);
     inode->sector = sector;
     inode->open_cnt = 1;
     inode->deny_write_cnt = 0;
     inode->removed = false;
-    block_read(fs_device, inode->sector, &inode->data);
+    rwlock_init(&inode->rwlock);
+    lock_init(&inode->dir_lock);
+    lock_init(&inode->index_lock);
+    inode->index_leaf = -1;
+    cache_read(inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+    lock_release(&open_inodes_lock);
     return inode;
 }
 
@@ -123,7 +380,9 @@ struct inode *
 inode_reopen(struct inode *inode)
 {
     if (inode != NULL) {
+        lock_acquire(&open_inodes_lock);
         inode->open_cnt++;
+        lock_release(&open_inodes_lock);
     }
     return inode;
 }
@@ -135,27 +394,53 @@ inode_get_inumber(const struct inode *inode)
     return inode->sector;
 }
 
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir(const struct inode *inode)
+{
+    return inode->data.is_dir;
+}
+
+/* Returns the number of openers of INODE. */
+int
+inode_open_cnt(struct inode *inode)
+{
+    int open_cnt;
+
+    lock_acquire(&open_inodes_lock);
+    open_cnt = inode->open_cnt;
+    lock_release(&open_inodes_lock);
+    return open_cnt;
+}
+
 /* Closes INODE and writes it to disk.
  * If this was the last reference to INODE, frees its memory.
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close(struct inode *inode)
 {
+    bool last;
+
     /* Ignore null pointer. */
     if (inode == NULL) {
         return;
     }
 
     /* Release resources if this was the last opener. */
-    if (--inode->open_cnt == 0) {
+    lock_acquire(&open_inodes_lock);
+    last = --inode->open_cnt == 0;
+    if (last) {
         /* Remove from inode list and release lock. */
         list_remove(&inode->elem);
+    }
+    lock_release(&open_inodes_lock);
 
-        /* Deallocate blocks if removed. */
+    if (last) {
+        /* Deallocate blocks if removed.  Nobody else can reach the
+         * inode any more, so the free map is updated unlocked. */
         if (inode->removed) {
             free_map_release(inode->sector, 1);
-            free_map_release(inode->data.start,
-                             bytes_to_sectors(inode->data.length));
+            inode_deallocate(&inode->data);
         }
 
         free(inode);
@@ -168,7 +453,21 @@ void
 inode_remove(struct inode *inode)
 {
     ASSERT(inode != NULL);
+    lock_acquire(&open_inodes_lock);
     inode->removed = true;
+    lock_release(&open_inodes_lock);
+}
+
+/* Returns true if INODE has been marked for deletion. */
+bool
+inode_is_removed(struct inode *inode)
+{
+    bool removed;
+
+    lock_acquire(&open_inodes_lock);
+    removed = inode->removed;
+    lock_release(&open_inodes_lock);
+    return removed;
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -179,8 +478,8 @@ inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
     uint8_t *buffer = buffer_;
     off_t bytes_read = 0;
-    uint8_t *bounce = NULL;
 
+    rwlock_acquire_read(&inode->rwlock);
     while (size > 0) {
         /* Disk sector to read, starting byte offset within sector. */
         block_sector_t sector_idx = byte_to_sector(inode, offset);
@@ -197,49 +496,54 @@ inode_read_at(struct inode *inode, void *buffer_, off_t size, off_t offset)
             break;
         }
 
-        if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
-            /* Read full sector directly into caller's buffer. */
-            block_read(fs_device, sector_idx, buffer + bytes_read);
-        } else {
-            /* Read sector into bounce buffer, then partially copy
-             * into caller's buffer. */
-            if (bounce == NULL) {
-                bounce = malloc(BLOCK_SECTOR_SIZE);
-                if (bounce == NULL) {
-                    break;
-                }
-            }
-            block_read(fs_device, sector_idx, bounce);
-            memcpy(buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+        cache_read(sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
 
         /* Advance. */
         size -= chunk_size;
         offset += chunk_size;
         bytes_read += chunk_size;
     }
-    free(bounce);
+    rwlock_release_read(&inode->rwlock);
 
     return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+ * A write past end of file extends the inode, filling any gap
+ * with zeros.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs. */
 off_t
 inode_write_at(struct inode *inode, const void *buffer_, off_t size,
                off_t offset)
 {
     const uint8_t *buffer = buffer_;
     off_t bytes_written = 0;
-    uint8_t *bounce = NULL;
 
+    rwlock_acquire_write(&inode->rwlock);
     if (inode->deny_write_cnt) {
+        rwlock_release_write(&inode->rwlock);
         return 0;
     }
 
+    /* Grow the inode first.  If the disk fills up, the loop below
+     * stops wherever the inode ended up. */
+    if (size > 0 && offset + size > inode->data.length) {
+        off_t old_length = inode->data.length;
+        off_t end = offset + size;
+
+        if (end > INODE_MAX_LENGTH) {
+            end = INODE_MAX_LENGTH;
+        }
+        inode_extend(&inode->data, inode->sector, end);
+        if (inode->data.length != old_length) {
+            cache_write(inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+        }
+        /* The extension may have filled in the cached index block.
+         * No reader can be using it while we hold RWLOCK. */
+        inode->index_leaf = -1;
+    }
+
     while (size > 0) {
         /* Sector to write, starting byte offset within sector. */
         block_sector_t sector_idx = byte_to_sector(inode, offset);
@@ -256,47 +560,71 @@ inode_write_at(struct inode *inode, const void *buffer_, off_t size,
             break;
         }
 
-        if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
-            /* Write full sector directly to disk. */
-            block_write(fs_device, sector_idx, buffer + bytes_written);
-        } else {
-            /* We need a bounce buffer. */
-            if (bounce == NULL) {
-                bounce = malloc(BLOCK_SECTOR_SIZE);
-                if (bounce == NULL) {
-                    break;
-                }
-            }
-
-            /* If the sector contains data before or after the chunk
-             * we're writing, then we need to read in the sector
-             * first.  Otherwise we start with a sector of all zeros. */
-            if (sector_ofs > 0 || chunk_size < sector_left) {
-                block_read(fs_device, sector_idx, bounce);
-            } else {
-                memset(bounce, 0, BLOCK_SECTOR_SIZE);
-            }
-            memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
-            block_write(fs_device, sector_idx, bounce);
-        }
+        /* The cache reads the sector in first unless the chunk
+         * covers all of it. */
+        cache_write(sector_idx, buffer + bytes_written, sector_ofs,
+                    chunk_size);
 
         /* Advance. */
         size -= chunk_size;
         offset += chunk_size;
         bytes_written += chunk_size;
     }
-    free(bounce);
+    rwlock_release_write(&inode->rwlock);
 
     return bytes_written;
 }
 
+/* Asks the buffer cache to fetch the sectors holding the SIZE
+ * bytes of INODE starting at OFFSET in the background.  Sectors
+ * past end of file are ignored.  Returns without waiting for any
+ * I/O. */
+void
+inode_read_ahead(struct inode *inode, off_t offset, off_t size)
+{
+    off_t end = offset + size;
+
+    rwlock_acquire_read(&inode->rwlock);
+    if (end > inode_length(inode)) {
+        end = inode_length(inode);
+    }
+    for (offset = ROUND_DOWN(offset, BLOCK_SECTOR_SIZE); offset < end;
+         offset += BLOCK_SECTOR_SIZE) {
+        cache_read_ahead(byte_to_sector(inode, offset));
+    }
+    rwlock_release_read(&inode->rwlock);
+}
+
+/* Returns the number of extents, that is, runs of consecutive
+ * sectors, holding INODE's data. */
+size_t
+inode_extent_cnt(struct inode *inode)
+{
+    block_sector_t prev = 0;
+    size_t extents = 0;
+    off_t ofs;
+
+    rwlock_acquire_read(&inode->rwlock);
+    for (ofs = 0; ofs < inode_length(inode); ofs += BLOCK_SECTOR_SIZE) {
+        block_sector_t sector = byte_to_sector(inode, ofs);
+        if (extents == 0 || sector != prev + 1) {
+            extents++;
+        }
+        prev = sector;
+    }
+    rwlock_release_read(&inode->rwlock);
+    return extents;
+}
+
 /* Disables writes to INODE.
  * May be called at most once per inode opener. */
 void
 inode_deny_write(struct inode *inode)
 {
+    rwlock_acquire_write(&inode->rwlock);
     inode->deny_write_cnt++;
     ASSERT(inode->deny_write_cnt <= inode->open_cnt);
+    rwlock_release_write(&inode->rwlock);
 }
 
 /* Re-enables writes to INODE.
@@ -305,9 +633,11 @@ inode_deny_write(struct inode *inode)
 void
 inode_allow_write(struct inode *inode)
 {
+    rwlock_acquire_write(&inode->rwlock);
     ASSERT(inode->deny_write_cnt > 0);
     ASSERT(inode->deny_write_cnt <= inode->open_cnt);
     inode->deny_write_cnt--;
+    rwlock_release_write(&inode->rwlock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -6,37 +6,74 @@
 
 #include "devices/block.h"
 #include "filesys/off_t.h"
+#include "threads/synch.h"
 
 struct bitmap;
 
+/* Number of data sectors an inode points to directly. */
+#define INODE_DIRECT_CNT 123
+
+/* Number of sector numbers that fit in one index block. */
+#define INODE_PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Largest file an inode can describe: the direct sectors, one
+ * single-indirect block and one doubly-indirect block. */
+#define INODE_MAX_LENGTH                                              \
+    ((off_t) (INODE_DIRECT_CNT + INODE_PTRS_PER_SECTOR                \
+              + INODE_PTRS_PER_SECTOR * INODE_PTRS_PER_SECTOR)        \
+     * BLOCK_SECTOR_SIZE)
+
 /* On-disk inode.
- * Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+ * Must be exactly BLOCK_SECTOR_SIZE bytes long.
+ * A sector number of 0 means "not allocated": sector 0 always
+ * holds the free map inode, so it is never a data sector. */
 struct inode_disk {
-    block_sector_t start;       /* First data sector. */
-    off_t          length;      /* File size in bytes. */
-    unsigned       magic;       /* Magic number. */
-    uint32_t       unused[125]; /* Not used. */
+    off_t          length;                   /* File size in bytes. */
+    unsigned       magic;                    /* Magic number. */
+    block_sector_t direct[INODE_DIRECT_CNT]; /* Direct data sectors. */
+    block_sector_t indirect;                 /* Single-indirect block. */
+    block_sector_t doubly_indirect;          /* Doubly-indirect block. */
+    bool           is_dir;                   /* Is this a directory? */
+    uint8_t        unused[3];                /* Not used. */
 };
 
-/* In-memory inode. */
+/* In-memory inode.
+ *
+ * ELEM, OPEN_CNT and REMOVED are protected by the open inodes
+ * lock in inode.c.  File contents and DENY_WRITE_CNT are
+ * protected by RWLOCK: readers share it, writers hold it
+ * exclusively.  DIR_LOCK is only used when the inode is a
+ * directory, to make lookup-then-modify sequences atomic. */
 struct inode {
     struct list_elem  elem;           /* Element in inode list. */
     block_sector_t    sector;         /* Sector number of disk location. */
     int               open_cnt;       /* Number of openers. */
     bool              removed;        /* True if deleted, false otherwise. */
     int               deny_write_cnt; /* 0: writes ok, >0: deny writes. */
+    struct rwlock     rwlock;         /* Guards contents, deny_write_cnt. */
+    struct lock       dir_lock;       /* Serializes directory updates. */
     struct inode_disk data;           /* Inode content. */
+
+    /* Copy of the index block used by the last indirect lookup. */
+    struct lock       index_lock;     /* Guards the two fields below. */
+    int               index_leaf;     /* Which block INDEX holds, or -1. */
+    block_sector_t    index[INODE_PTRS_PER_SECTOR]; /* Its contents. */
 };
 
 void inode_init(void);
-bool inode_create(block_sector_t, off_t);
+bool inode_create(block_sector_t, off_t, bool is_dir);
 struct inode *inode_open(block_sector_t);
 struct inode *inode_reopen(struct inode *);
 block_sector_t inode_get_inumber(const struct inode *);
+bool inode_is_dir(const struct inode *);
+int inode_open_cnt(struct inode *);
 void inode_close(struct inode *);
 void inode_remove(struct inode *);
+bool inode_is_removed(struct inode *);
 off_t inode_read_at(struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at(struct inode *, const void *, off_t size, off_t offset);
+void inode_read_ahead(struct inode *, off_t offset, off_t size);
+size_t inode_extent_cnt(struct inode *);
 void inode_deny_write(struct inode *);
 void inode_allow_write(struct inode *);
 off_t inode_length(const struct inode *);
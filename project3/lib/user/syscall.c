@@ -182,3 +182,21 @@ inumber(int fd)
 {
     return syscall1(SYS_INUMBER, fd);
 }
+
+pid_t
+fork(void)
+{
+    return syscall0(SYS_FORK);
+}
+
+int
+readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    return syscall3(SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    return syscall3(SYS_WRITEV, fd, iov, iovcnt);
+}
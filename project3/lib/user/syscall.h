@@ -3,6 +3,7 @@
 
 #include <debug.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +13,15 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t)-1)
 
+/* A buffer for readv() and writev(). */
+struct iovec {
+    void *iov_base; /* Start of the buffer. */
+    size_t iov_len; /* Size of the buffer in bytes. */
+};
+
+/* Maximum number of buffers readv() and writev() accept. */
+#define IOV_MAX 1024
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -45,4 +55,9 @@ bool readdir(int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir(int fd);
 int inumber(int fd);
 
+/* Extensions. */
+pid_t fork(void);
+int readv(int fd, const struct iovec *, int iovcnt);
+int writev(int fd, const struct iovec *, int iovcnt);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,51 @@
+/* Child process for syn-indep test.
+   Creates a file private to this child, fills it a small chunk
+   at a time, then reads it back a byte at a time, so that the
+   kernel file system code sees many short operations from
+   several processes at once. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-indep.h"
+
+const char *test_name = "child-syn-indep";
+
+static char buf[FILE_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  int child_idx;
+  int fd;
+  size_t i;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "indep-%d", child_idx);
+
+  random_init (child_idx);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (i = 0; i < sizeof buf; i += WRITE_SIZE)
+    CHECK (write (fd, buf + i, WRITE_SIZE) == WRITE_SIZE,
+           "write \"%s\"", file_name);
+
+  seek (fd, 0);
+  for (i = 0; i < sizeof buf; i++) 
+    {
+      char c;
+      CHECK (read (fd, &c, 1) > 0, "read \"%s\"", file_name);
+      compare_bytes (&c, buf + i, 1, i, file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,66 @@
+/* Fragmentation benchmark.  In each of several rounds, creates
+   files of mixed sizes, removes every other one to punch holes
+   in free space, and then grows the survivors by appending to
+   them.  The kernel prints the resulting number of extents per
+   file and free extents at shutdown ("Filesys: ..." and "Free
+   map: ..."); this test only checks that the churn succeeds. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 6
+#define FILES_PER_ROUND 10
+#define MAX_SECTORS 24
+
+static char buf[512 * MAX_SECTORS];
+
+/* Returns a random size of between 1 and MAX_SECTORS sectors,
+   not necessarily a multiple of the sector size. */
+static size_t
+random_size (void) 
+{
+  return (random_ulong () % MAX_SECTORS) * 512 + random_ulong () % 512 + 1;
+}
+
+void
+test_main (void) 
+{
+  int round, i;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      char name[16];
+
+      quiet = true;
+      for (i = 0; i < FILES_PER_ROUND; i++) 
+        {
+          snprintf (name, sizeof name, "f%d-%d", round, i);
+          CHECK (create (name, random_size ()), "create \"%s\"", name);
+        }
+      for (i = 1; i < FILES_PER_ROUND; i += 2) 
+        {
+          snprintf (name, sizeof name, "f%d-%d", round, i);
+          CHECK (remove (name), "remove \"%s\"", name);
+        }
+      for (i = 0; i < FILES_PER_ROUND; i += 2) 
+        {
+          size_t size = random_size ();
+          int fd;
+
+          snprintf (name, sizeof name, "f%d-%d", round, i);
+          CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+          seek (fd, filesize (fd));
+          CHECK (write (fd, buf, size) == (int) size,
+                 "append %zu bytes to \"%s\"", size, name);
+          close (fd);
+        }
+      quiet = false;
+      msg ("round %d: created %d files, removed %d, grew %d", round,
+           FILES_PER_ROUND, FILES_PER_ROUND / 2, FILES_PER_ROUND / 2);
+    }
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(frag-churn) begin
+(frag-churn) round 0: created 10 files, removed 5, grew 5
+(frag-churn) round 1: created 10 files, removed 5, grew 5
+(frag-churn) round 2: created 10 files, removed 5, grew 5
+(frag-churn) round 3: created 10 files, removed 5, grew 5
+(frag-churn) round 4: created 10 files, removed 5, grew 5
+(frag-churn) round 5: created 10 files, removed 5, grew 5
+(frag-churn) end
+EOF
+pass;
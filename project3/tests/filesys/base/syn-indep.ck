@@ -0,0 +1,59 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-indep) begin
+(syn-indep) exec child 1 of 10: "child-syn-indep 0"
+(syn-indep) exec child 2 of 10: "child-syn-indep 1"
+(syn-indep) exec child 3 of 10: "child-syn-indep 2"
+(syn-indep) exec child 4 of 10: "child-syn-indep 3"
+(syn-indep) exec child 5 of 10: "child-syn-indep 4"
+(syn-indep) exec child 6 of 10: "child-syn-indep 5"
+(syn-indep) exec child 7 of 10: "child-syn-indep 6"
+(syn-indep) exec child 8 of 10: "child-syn-indep 7"
+(syn-indep) exec child 9 of 10: "child-syn-indep 8"
+(syn-indep) exec child 10 of 10: "child-syn-indep 9"
+(syn-indep) wait for child 1 of 10 returned 0 (expected 0)
+(syn-indep) wait for child 2 of 10 returned 1 (expected 1)
+(syn-indep) wait for child 3 of 10 returned 2 (expected 2)
+(syn-indep) wait for child 4 of 10 returned 3 (expected 3)
+(syn-indep) wait for child 5 of 10 returned 4 (expected 4)
+(syn-indep) wait for child 6 of 10 returned 5 (expected 5)
+(syn-indep) wait for child 7 of 10 returned 6 (expected 6)
+(syn-indep) wait for child 8 of 10 returned 7 (expected 7)
+(syn-indep) wait for child 9 of 10 returned 8 (expected 8)
+(syn-indep) wait for child 10 of 10 returned 9 (expected 9)
+(syn-indep) open "indep-0" for verification
+(syn-indep) verified contents of "indep-0"
+(syn-indep) close "indep-0"
+(syn-indep) open "indep-1" for verification
+(syn-indep) verified contents of "indep-1"
+(syn-indep) close "indep-1"
+(syn-indep) open "indep-2" for verification
+(syn-indep) verified contents of "indep-2"
+(syn-indep) close "indep-2"
+(syn-indep) open "indep-3" for verification
+(syn-indep) verified contents of "indep-3"
+(syn-indep) close "indep-3"
+(syn-indep) open "indep-4" for verification
+(syn-indep) verified contents of "indep-4"
+(syn-indep) close "indep-4"
+(syn-indep) open "indep-5" for verification
+(syn-indep) verified contents of "indep-5"
+(syn-indep) close "indep-5"
+(syn-indep) open "indep-6" for verification
+(syn-indep) verified contents of "indep-6"
+(syn-indep) close "indep-6"
+(syn-indep) open "indep-7" for verification
+(syn-indep) verified contents of "indep-7"
+(syn-indep) close "indep-7"
+(syn-indep) open "indep-8" for verification
+(syn-indep) verified contents of "indep-8"
+(syn-indep) close "indep-8"
+(syn-indep) open "indep-9" for verification
+(syn-indep) verified contents of "indep-9"
+(syn-indep) close "indep-9"
+(syn-indep) end
+EOF
+pass;
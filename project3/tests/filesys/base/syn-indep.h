@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_BASE_SYN_INDEP_H
+#define TESTS_FILESYS_BASE_SYN_INDEP_H
+
+#define CHILD_CNT 10
+#define FILE_SIZE 4096
+#define WRITE_SIZE 64
+
+#endif /* tests/filesys/base/syn-indep.h */
@@ -0,0 +1,60 @@
+/* Creates N threads that each sleep for the same long interval
+   and reports how many of the elapsed timer ticks were spent in
+   the idle thread.  Sleeping threads should be blocked rather
+   than repeatedly rescheduled, so nearly every tick of the
+   interval should be idle.  The same figure appears in the
+   "Thread: ... idle ticks" line printed at shutdown. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 100
+#define SLEEP_TICKS 200
+
+static void sleeper (void *);
+
+void
+test_alarm_idle (void) 
+{
+  struct semaphore done;
+  int64_t start_time, start_idle;
+  int64_t elapsed, idle;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep %d ticks each.",
+       THREAD_CNT, SLEEP_TICKS);
+
+  sema_init (&done, 0);
+  start_time = timer_ticks ();
+  start_idle = thread_get_idle_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT, sleeper, &done);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  elapsed = timer_elapsed (start_time);
+  idle = thread_get_idle_ticks () - start_idle;
+  msg ("idle for %lld of %lld ticks", idle, elapsed);
+  thread_print_stats ();
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  timer_sleep (SLEEP_TICKS);
+  sema_up (done);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+my ($idle, $elapsed);
+for (@output) {
+    ($idle, $elapsed) = /^\(alarm-idle\) idle for (\d+) of (\d+) ticks$/
+      and last;
+}
+fail "missing idle tick report in output\n" if !defined $idle;
+fail "only $idle of $elapsed ticks were idle while threads slept\n"
+  if $idle * 2 < $elapsed;
+
+pass;
@@ -0,0 +1,45 @@
+/* Opens the same file FD_CNT times, closes every other
+   descriptor, and opens it again FD_CNT / 2 times.  Every open
+   must succeed, and the reopened descriptors must be exactly the
+   ones that were closed, not new ones. */
+
+#include <stdbool.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FD_CNT 1000
+#define FD_LIMIT (4 * FD_CNT)
+
+static int fds[FD_CNT];
+static bool closed[FD_LIMIT];
+
+void
+test_main (void) 
+{
+  int i;
+
+  quiet = true;
+  for (i = 0; i < FD_CNT; i++) 
+    {
+      CHECK ((fds[i] = open ("sample.txt")) > 1, "open #%d", i);
+      if (fds[i] >= FD_LIMIT)
+        fail ("open #%d returned fd %d", i, fds[i]);
+    }
+  for (i = 0; i < FD_CNT; i += 2) 
+    {
+      close (fds[i]);
+      closed[fds[i]] = true;
+    }
+  for (i = 0; i < FD_CNT; i += 2) 
+    {
+      int fd = open ("sample.txt");
+      if (fd < 2 || fd >= FD_LIMIT || !closed[fd])
+        fail ("reopen #%d returned fd %d, not a closed one", i / 2, fd);
+      closed[fd] = false;
+    }
+  quiet = false;
+
+  msg ("opened %d files and reused %d closed descriptors",
+       FD_CNT, FD_CNT / 2);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) opened 1000 files and reused 500 closed descriptors
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
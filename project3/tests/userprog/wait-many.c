@@ -0,0 +1,33 @@
+/* Spawns CHILD_CNT child processes, BATCH_CNT at a time, and
+   waits for each of them.  Each wait finds its child's exit
+   status in the parent's list of children while a whole batch
+   of processes is alive, so this checks that exec and wait keep
+   working, and keep up, as processes come and go in numbers. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 200
+#define BATCH_CNT 20
+
+void
+test_main (void) 
+{
+  pid_t pids[BATCH_CNT];
+  int batch, i;
+
+  quiet = true;
+  for (batch = 0; batch < CHILD_CNT / BATCH_CNT; batch++) 
+    {
+      for (i = 0; i < BATCH_CNT; i++)
+        CHECK ((pids[i] = exec ("child-simple")) != PID_ERROR,
+               "exec child %d", batch * BATCH_CNT + i);
+      for (i = 0; i < BATCH_CNT; i++)
+        CHECK (wait (pids[i]) == 81,
+               "wait for child %d", batch * BATCH_CNT + i);
+    }
+  quiet = false;
+
+  msg ("spawned and reaped %d children", CHILD_CNT);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+my ($runs) = scalar (grep (/^\(child-simple\) run$/, @output));
+my ($exits) = scalar (grep (/^child-simple: exit\(81\)$/, @output));
+fail "expected 200 children to run, but $runs did\n" if $runs != 200;
+fail "expected 200 children to exit, but $exits did\n" if $exits != 200;
+fail "missing summary in output\n"
+  unless grep ($_ eq '(wait-many) spawned and reaped 200 children', @output);
+fail "wait-many did not exit cleanly\n"
+  unless grep ($_ eq 'wait-many: exit(0)', @output);
+
+pass;
@@ -0,0 +1,37 @@
+/* Writes sample.txt to a new file in pieces with writev(), one of
+   them empty, then reads it back with readv() split at another
+   point and checks the result. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  struct iovec iov[3];
+  int handle;
+
+  CHECK (create ("test.txt", size), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = sample + 10;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 10;
+  iov[2].iov_len = size - 10;
+  CHECK (writev (handle, iov, 3) == (int) size, "writev \"test.txt\"");
+
+  seek (handle, 0);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 100;
+  iov[1].iov_base = buf + 100;
+  iov[1].iov_len = sizeof buf - 100;
+  CHECK (readv (handle, iov, 2) == (int) size, "readv \"test.txt\"");
+  CHECK (!memcmp (buf, sample, size), "compare read data against written data");
+}
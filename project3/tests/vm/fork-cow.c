@@ -0,0 +1,37 @@
+/* Forks a child that checks it sees the parent's data, then
+   overwrites a page of it and exits.  The parent waits for the
+   child and verifies that its own copy is unchanged, since the
+   two only share the page until one of them writes to it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096 * 2];
+
+void
+test_main (void)
+{
+  pid_t child;
+  int status;
+
+  memset (buf, 'p', sizeof buf);
+  child = fork ();
+  if (child == 0)
+    {
+      size_t i;
+
+      for (i = 0; i < sizeof buf; i++)
+        if (buf[i] != 'p')
+          exit (-1);
+      memset (buf, 'c', sizeof buf);
+      exit (buf[sizeof buf - 1] == 'c' ? 81 : -1);
+    }
+  /* Wait before printing, so that the child's exit message comes
+     first. */
+  status = child > 0 ? wait (child) : -1;
+  CHECK (status == 81, "fork and wait for child");
+  CHECK (buf[0] == 'p' && buf[sizeof buf - 1] == 'p',
+         "parent's copy unchanged");
+}
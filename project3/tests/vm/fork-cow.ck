@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+fork-cow: exit(81)
+(fork-cow) fork and wait for child
+(fork-cow) parent's copy unchanged
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
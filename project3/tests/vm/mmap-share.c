@@ -0,0 +1,39 @@
+/* Maps the same file at two addresses, writes through one
+   mapping and verifies that the data is visible through the
+   other at once, since both map the same frame.  Then unmaps
+   both and reads the data back using the read system call. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *actual[2] = {(char *) 0x10000000, (char *) 0x20000000};
+  mapid_t map[2];
+  int handle[2];
+  char buf[1024];
+  size_t i;
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  for (i = 0; i < 2; i++) 
+    {
+      CHECK ((handle[i] = open ("sample.txt")) > 1,
+             "open \"sample.txt\" #%zu", i);
+      CHECK ((map[i] = mmap (handle[i], actual[i])) != MAP_FAILED,
+             "mmap \"sample.txt\" #%zu at %p", i, (void *) actual[i]);
+    }
+
+  memcpy (actual[0], sample, strlen (sample));
+  CHECK (!memcmp (actual[1], sample, strlen (sample)),
+         "compare mmap'd file 1 against data written to file 0");
+
+  for (i = 0; i < 2; i++) 
+    munmap (map[i]);
+  read (handle[0], buf, strlen (sample));
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+}
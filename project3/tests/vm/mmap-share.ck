@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-share) begin
+(mmap-share) create "sample.txt"
+(mmap-share) open "sample.txt" #0
+(mmap-share) mmap "sample.txt" #0 at 0x10000000
+(mmap-share) open "sample.txt" #1
+(mmap-share) mmap "sample.txt" #1 at 0x20000000
+(mmap-share) compare mmap'd file 1 against data written to file 0
+(mmap-share) compare read data against written data
+(mmap-share) end
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Reads every page of a large BSS array, which should all be
+   zero and may all be the same frame, then writes a different
+   value to each page and checks that the pages did not share
+   the writes. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+  msg ("read pass");
+
+  for (i = 0; i < SIZE; i += 4096)
+    buf[i] = 'a' + i / 4096 % 26;
+  msg ("write pass");
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (i % 4096 == 0 ? 'a' + (int) (i / 4096 % 26) : 0))
+      fail ("byte %zu is wrong", i);
+  msg ("read pass");
+}
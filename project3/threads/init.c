@@ -38,6 +38,11 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -130,6 +135,11 @@ main(void)
     locate_block_devices();
     filesys_init(format_filesys);
 #endif
+#ifdef VM
+    /* Initialize virtual memory. */
+    swap_init();
+    frame_init();
+#endif
 
     printf("Boot complete.\n");
 
@@ -256,6 +266,15 @@ parse_options(char **argv)
 #ifdef VM
         else if (!strcmp(name, "-swap")) {
             swap_bdev_name = value;
+        } else if (!strcmp(name, "-sl")) {
+            /* The stack must fit below PHYS_BASE, or the bottom of
+             * the stack region wraps around. */
+            int cnt = atoi(value);
+            if (cnt < 1 || (uintptr_t) cnt > (uintptr_t) PHYS_BASE / PGSIZE) {
+                PANIC("-sl=%s out of range, must be 1 to %"PRIuPTR" pages",
+                      value, (uintptr_t) PHYS_BASE / PGSIZE);
+            }
+            stack_page_limit = cnt;
         }
 #endif
 #endif
@@ -386,6 +405,7 @@ usage(void)
            "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
            "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+           "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
 #endif
 #endif
            "  -rs=SEED           Set random number seed to SEED.\n"
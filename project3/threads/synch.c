@@ -33,6 +33,11 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 
+/* Maximum length of a lock chain along which priority is
+ * donated.  Bounds the work done in lock_acquire() and breaks
+ * out of (erroneous) circular waits. */
+#define DONATION_DEPTH_MAX 8
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
  * nonnegative integer along with two atomic operators for
  * manipulating it:
@@ -101,7 +106,15 @@ sema_try_down(struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
- * and wakes up one thread of those waiting for SEMA, if any.
+ * and wakes up the highest-priority thread of those waiting for
+ * SEMA, if any.  Waiters of equal priority are woken in FIFO
+ * order.  The priority of a waiter may change while it waits
+ * (see lock_acquire()), so the waiter list is searched here
+ * rather than kept sorted.
+ *
+ * Like thread_unblock(), preempts the running thread in favor of
+ * the woken thread only if interrupts were on at entry or if
+ * called from an interrupt handler.
  *
  * This function may be called from an interrupt handler. */
 void
@@ -113,11 +126,18 @@ sema_up(struct semaphore *sema)
 
     old_level = intr_disable();
     if (!list_empty(&sema->waiters)) {
-        thread_unblock(list_entry(list_pop_front(&sema->waiters),
-                                  struct thread, elem));
+        struct list_elem *e = list_max(&sema->waiters,
+                                       thread_priority_less, NULL);
+        list_remove(e);
+        thread_unblock(list_entry(e, struct thread, elem));
     }
     sema->value++;
     intr_set_level(old_level);
+
+    /* thread_unblock() could not preempt us with interrupts off. */
+    if (old_level == INTR_ON || intr_context()) {
+        thread_preempt();
+    }
 }
 
 static void sema_test_helper(void *sema_);
@@ -183,6 +203,12 @@ lock_init(struct lock *lock)
  * necessary.  The lock must not already be held by the current
  * thread.
  *
+ * If LOCK is held by a lower-priority thread, the current thread
+ * donates its priority to the holder, and onward along the chain
+ * of locks the holder is itself waiting for, up to
+ * DONATION_DEPTH_MAX links.  The 4.4BSD scheduler does not use
+ * priority donation.
+ *
  * This function may sleep, so it must not be called within an
  * interrupt handler.  This function may be called with
  * interrupts disabled, but interrupts will be turned back on if
@@ -190,12 +216,34 @@ lock_init(struct lock *lock)
 void
 lock_acquire(struct lock *lock)
 {
+    struct thread *cur = thread_current();
+    enum intr_level old_level;
+
     ASSERT(lock != NULL);
     ASSERT(!intr_context());
     ASSERT(!lock_held_by_current_thread(lock));
 
+    old_level = intr_disable();
+    if (lock->holder != NULL && !thread_mlfqs) {
+        struct lock *l = lock;
+        int depth;
+
+        cur->waiting_lock = lock;
+        for (depth = 0; l != NULL && l->holder != NULL
+             && depth < DONATION_DEPTH_MAX; depth++) {
+            if (l->holder->priority >= cur->priority) {
+                break;
+            }
+            thread_donate_priority(l->holder, cur->priority);
+            l = l->holder->waiting_lock;
+        }
+    }
+
     sema_down(&lock->semaphore);
-    lock->holder = thread_current();
+    cur->waiting_lock = NULL;
+    lock->holder = cur;
+    list_push_back(&cur->held_locks, &lock->elem);
+    intr_set_level(old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -207,19 +255,25 @@ lock_acquire(struct lock *lock)
 bool
 lock_try_acquire(struct lock *lock)
 {
+    enum intr_level old_level;
     bool success;
 
     ASSERT(lock != NULL);
     ASSERT(!lock_held_by_current_thread(lock));
 
+    old_level = intr_disable();
     success = sema_try_down(&lock->semaphore);
     if (success) {
         lock->holder = thread_current();
+        list_push_back(&lock->holder->held_locks, &lock->elem);
     }
+    intr_set_level(old_level);
     return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+ * Any priority donated through LOCK is returned, and the current
+ * thread yields if a waiter now outranks it.
  *
  * An interrupt handler cannot acquire a lock, so it does not
  * make sense to try to release a lock within an interrupt
@@ -227,10 +281,20 @@ lock_try_acquire(struct lock *lock)
 void
 lock_release(struct lock *lock)
 {
+    struct thread *cur = thread_current();
+    enum intr_level old_level;
+
     ASSERT(lock != NULL);
     ASSERT(lock_held_by_current_thread(lock));
 
+    old_level = intr_disable();
+    list_remove(&lock->elem);
     lock->holder = NULL;
+    if (!thread_mlfqs) {
+        thread_update_priority(cur);
+    }
+    intr_set_level(old_level);
+
     sema_up(&lock->semaphore);
 }
 
@@ -249,8 +313,11 @@ lock_held_by_current_thread(const struct lock *lock)
 struct semaphore_elem {
     struct list_elem elem;      /* List element. */
     struct semaphore semaphore; /* This semaphore. */
+    struct thread   *thread;    /* Thread waiting on the semaphore. */
 };
 
+static list_less_func semaphore_elem_less;
+
 /* Initializes condition variable COND.  A condition variable
  * allows one piece of code to signal a condition and cooperating
  * code to receive the signal and act upon it. */
@@ -293,6 +360,7 @@ cond_wait(struct condition *cond, struct lock *lock)
     ASSERT(lock_held_by_current_thread(lock));
 
     sema_init(&waiter.semaphore, 0);
+    waiter.thread = thread_current();
     list_push_back(&cond->waiters, &waiter.elem);
     lock_release(lock);
     sema_down(&waiter.semaphore);
@@ -300,8 +368,8 @@ cond_wait(struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
- * this function signals one of them to wake up from its wait.
- * LOCK must be held before calling this function.
+ * this function signals the highest-priority one to wake up from
+ * its wait.  LOCK must be held before calling this function.
  *
  * An interrupt handler cannot acquire a lock, so it does not
  * make sense to try to signal a condition variable within an
@@ -315,11 +383,25 @@ cond_signal(struct condition *cond, struct lock *lock UNUSED)
     ASSERT(lock_held_by_current_thread(lock));
 
     if (!list_empty(&cond->waiters)) {
-        sema_up(&list_entry(list_pop_front(&cond->waiters),
-                            struct semaphore_elem, elem)->semaphore);
+        struct list_elem *e = list_max(&cond->waiters,
+                                       semaphore_elem_less, NULL);
+        list_remove(e);
+        sema_up(&list_entry(e, struct semaphore_elem, elem)->semaphore);
     }
 }
 
+/* Orders condition variable waiters by increasing priority of
+ * the waiting thread. */
+static bool
+semaphore_elem_less(const struct list_elem *a_, const struct list_elem *b_,
+                    void *aux UNUSED)
+{
+    const struct semaphore_elem *a = list_entry(a_, struct semaphore_elem, elem);
+    const struct semaphore_elem *b = list_entry(b_, struct semaphore_elem, elem);
+
+    return a->thread->priority < b->thread->priority;
+}
+
 /* Wakes up all threads, if any, waiting on COND (protected by
  * LOCK).  LOCK must be held before calling this function.
  *
@@ -336,3 +418,102 @@ cond_broadcast(struct condition *cond, struct lock *lock)
         cond_signal(cond, lock);
     }
 }
+
+/* Initializes RW as a readers-writer lock that nobody holds. */
+void
+rwlock_init(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    lock_init(&rw->lock);
+    cond_init(&rw->readers_ok);
+    cond_init(&rw->writers_ok);
+    rw->readers = 0;
+    rw->waiting_writers = 0;
+    rw->writer = NULL;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+ * is waiting for it.
+ *
+ * This function may sleep, so it must not be called within an
+ * interrupt handler. */
+void
+rwlock_acquire_read(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+    ASSERT(!intr_context());
+
+    lock_acquire(&rw->lock);
+    while (rw->writer != NULL || rw->waiting_writers > 0) {
+        cond_wait(&rw->readers_ok, &rw->lock);
+    }
+    rw->readers++;
+    lock_release(&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+ * The last reader out lets a waiting writer in. */
+void
+rwlock_release_read(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    lock_acquire(&rw->lock);
+    ASSERT(rw->readers > 0);
+    if (--rw->readers == 0) {
+        cond_signal(&rw->writers_ok, &rw->lock);
+    }
+    lock_release(&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until there are no readers
+ * and no other writer.
+ *
+ * This function may sleep, so it must not be called within an
+ * interrupt handler. */
+void
+rwlock_acquire_write(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+    ASSERT(!intr_context());
+    ASSERT(!rwlock_held_for_write(rw));
+
+    lock_acquire(&rw->lock);
+    rw->waiting_writers++;
+    while (rw->writer != NULL || rw->readers > 0) {
+        cond_wait(&rw->writers_ok, &rw->lock);
+    }
+    rw->waiting_writers--;
+    rw->writer = thread_current();
+    lock_release(&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for writing.
+ * Hands the lock to the next writer if there is one, otherwise
+ * wakes every waiting reader. */
+void
+rwlock_release_write(struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+    ASSERT(rwlock_held_for_write(rw));
+
+    lock_acquire(&rw->lock);
+    rw->writer = NULL;
+    if (rw->waiting_writers > 0) {
+        cond_signal(&rw->writers_ok, &rw->lock);
+    } else {
+        cond_broadcast(&rw->readers_ok, &rw->lock);
+    }
+    lock_release(&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing,
+ * false otherwise. */
+bool
+rwlock_held_for_write(const struct rwlock *rw)
+{
+    ASSERT(rw != NULL);
+
+    return rw->writer == thread_current();
+}
@@ -18,8 +18,9 @@ void sema_self_test(void);
 
 /* Lock. */
 struct lock {
-    struct thread   *holder;    /* Thread holding lock (for debugging). */
+    struct thread   *holder;    /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks list. */
 };
 
 void lock_init(struct lock *);
@@ -38,6 +39,26 @@ void cond_wait(struct condition *, struct lock *);
 void cond_signal(struct condition *, struct lock *);
 void cond_broadcast(struct condition *, struct lock *);
 
+/* Readers-writer lock.
+ * Any number of readers may hold the lock at once, or a single
+ * writer.  Waiting writers block new readers, so a steady stream
+ * of readers cannot starve a writer. */
+struct rwlock {
+    struct lock      lock;            /* Protects the fields below. */
+    struct condition readers_ok;      /* Signaled when readers may enter. */
+    struct condition writers_ok;      /* Signaled when a writer may enter. */
+    int              readers;         /* Number of active readers. */
+    int              waiting_writers; /* Number of blocked writers. */
+    struct thread   *writer;          /* Active writer, if any. */
+};
+
+void rwlock_init(struct rwlock *);
+void rwlock_acquire_read(struct rwlock *);
+void rwlock_release_read(struct rwlock *);
+void rwlock_acquire_write(struct rwlock *);
+void rwlock_release_write(struct rwlock *);
+bool rwlock_held_for_write(const struct rwlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -12,6 +12,7 @@
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -23,9 +24,18 @@
  * of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
- * that are ready to run but not actually running. */
-static struct list ready_list;
+#if PRI_MIN != 0 || PRI_MAX >= 64
+#error ready_mask requires priorities in the range 0...63
+#endif
+
+/* Run queues of processes in THREAD_READY state, that is,
+ * processes that are ready to run but not actually running.
+ * There is one FIFO queue per priority level, and bit P of
+ * ready_mask is set exactly when ready_queues[P] is non-empty, so
+ * the highest-priority ready thread is found with a single
+ * bit scan instead of a list walk. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_mask;
 
 /* List of all processes.  Processes are added to this list
  * when they are first scheduled and removed when they exit. */
@@ -56,6 +66,21 @@ static long long user_ticks;   /* # of timer ticks in user programs. */
 #define TIME_SLICE 4 /* # of timer ticks to give each thread. */
 static unsigned thread_ticks; /* # of timer ticks since last yield. */
 
+/* Number of threads in the run queues, not counting the running
+ * thread.  Maintained for the load average. */
+static int ready_count;
+
+/* 4.4BSD scheduler state.
+ *
+ * Only the running thread's recent_cpu changes between the
+ * once-per-second updates, so a priority recalculation need only
+ * visit the threads that ran since the last one.  Those threads
+ * are kept on dirty_list, which is accessed only with interrupts
+ * off. */
+#define PRI_RECALC_TICKS 4  /* Recalculate priorities this often. */
+static fixed_t load_avg;    /* System load average. */
+static struct list dirty_list; /* Threads whose priority is stale. */
+
 /* If false (default), use round-robin scheduler.
  * If true, use multi-level feedback queue scheduler.
  * Controlled by kernel command-line option "-o mlfqs". */
@@ -69,6 +94,20 @@ static struct thread *running_thread(void);
 
 static struct thread *next_thread_to_run(void);
 
+static void ready_queue_push(struct thread *);
+
+static void ready_queue_remove(struct thread *);
+
+static void set_effective_priority(struct thread *, int priority);
+
+static void mlfqs_tick(struct thread *cur);
+
+static void mlfqs_update_priority(struct thread *t);
+
+static thread_action_func mlfqs_decay;
+
+static int ready_max_priority(void);
+
 static void init_thread(struct thread *, const char *name, int priority);
 
 static bool is_thread(struct thread *) UNUSED;
@@ -96,11 +135,18 @@ static tid_t allocate_tid(void);
 void
 thread_init(void)
 {
+    int i;
+
     ASSERT(intr_get_level() == INTR_OFF);
 
     lock_init(&tid_lock);
-    list_init(&ready_list);
+    for (i = PRI_MIN; i <= PRI_MAX; i++) {
+        list_init(&ready_queues[i]);
+    }
+    ready_mask = 0;
     list_init(&all_list);
+    list_init(&dirty_list);
+    load_avg = fix_int(0);
 
     /* Set up a thread structure for the running thread. */
     initial_thread = running_thread();
@@ -115,6 +161,7 @@ void
 thread_start(void)
 {
     log(L_TRACE, "thread_start");
+
     /* Create the idle thread. */
     struct semaphore idle_started;
     sema_init(&idle_started, 0);
@@ -147,6 +194,10 @@ thread_tick(void)
         kernel_ticks++;
     }
 
+    if (thread_mlfqs) {
+        mlfqs_tick(t);
+    }
+
     /* Enforce preemption. */
     if (++thread_ticks >= TIME_SLICE) {
         intr_yield_on_return();
@@ -161,6 +212,18 @@ thread_print_stats(void)
            idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Returns the number of timer ticks spent in the idle thread
+ * since boot. */
+int64_t
+thread_get_idle_ticks(void)
+{
+    enum intr_level old_level = intr_disable();
+    int64_t t = idle_ticks;
+
+    intr_set_level(old_level);
+    return t;
+}
+
 /* Creates a new kernel thread named NAME with the given initial
  * PRIORITY, which executes FUNCTION passing AUX as the argument,
  * and adds it to the ready queue.  Returns the thread identifier
@@ -173,9 +236,8 @@ thread_print_stats(void)
  * scheduled.  Use a semaphore or some other form of
  * synchronization if you need to ensure ordering.
  *
- * The code provided sets the new thread's `priority' member to
- * PRIORITY, but no actual priority scheduling is implemented.
- * Priority scheduling is the goal of Problem 1-3. */
+ * If the new thread has a higher priority than the running
+ * thread, the running thread yields to it immediately. */
 tid_t
 thread_create(const char *name, int priority,
               thread_func *function, void *aux)
@@ -184,6 +246,7 @@ thread_create(const char *name, int priority,
     struct kernel_thread_frame *kf;
     struct switch_entry_frame *ef;
     struct switch_threads_frame *sf;
+    enum intr_level old_level;
     tid_t tid;
 
     ASSERT(function != NULL);
@@ -198,6 +261,17 @@ thread_create(const char *name, int priority,
     init_thread(t, name, priority);
     tid = t->tid = allocate_tid();
 
+    /* Under the 4.4BSD scheduler, the new thread inherits its
+     * parent's niceness and recent_cpu, and the requested priority
+     * is ignored.  The idle thread stays at PRI_MIN. */
+    if (thread_mlfqs && function != idle) {
+        old_level = intr_disable();
+        t->nice = thread_current()->nice;
+        t->recent_cpu = thread_current()->recent_cpu;
+        mlfqs_update_priority(t);
+        intr_set_level(old_level);
+    }
+
     /* Stack frame for kernel_thread(). */
     kf = alloc_frame(t, sizeof *kf);
     kf->eip = NULL;
@@ -213,13 +287,6 @@ thread_create(const char *name, int priority,
     sf->eip = switch_entry;
     sf->ebp = 0;
 
-    /* Initilize exit semaphore */
-    sema_init(&t->myself_wait_for_parent_exit, 0);
-    sema_init(&t->parent_wait_for_my_exit, 0);
-    sema_init(&t->myself_wait_for_child_exit, 0);
-    sema_init(&t->child_wait_for_my_exit, 0);
-    sema_init(&t->exec_wait_on_child_register, 0);
-    
     /* Add to run queue. */
     thread_unblock(t);
 
@@ -246,10 +313,12 @@ thread_block(void)
  * This is an error if T is not blocked.  (Use thread_yield() to
  * make the running thread ready.)
  *
- * This function does not preempt the running thread.  This can
- * be important: if the caller had disabled interrupts itself,
- * it may expect that it can atomically unblock a thread and
- * update other data. */
+ * If T has a higher priority than the running thread, the
+ * running thread is preempted, but only when the caller had
+ * interrupts enabled or is an interrupt handler.  This can be
+ * important: if the caller had disabled interrupts itself, it
+ * may expect that it can atomically unblock a thread and update
+ * other data, and must call thread_preempt() itself afterward. */
 void
 thread_unblock(struct thread *t)
 {
@@ -259,9 +328,32 @@ thread_unblock(struct thread *t)
 
     old_level = intr_disable();
     ASSERT(t->status == THREAD_BLOCKED);
-    list_push_back(&ready_list, &t->elem);
+    ready_queue_push(t);
     t->status = THREAD_READY;
     intr_set_level(old_level);
+
+    if (old_level == INTR_ON || intr_context()) {
+        thread_preempt();
+    }
+}
+
+/* Yields the CPU if a ready thread has a higher priority than
+ * the running thread.  Within an interrupt handler, the yield is
+ * deferred until the handler returns. */
+void
+thread_preempt(void)
+{
+    enum intr_level old_level = intr_disable();
+    bool preempt = ready_max_priority() > thread_current()->priority;
+
+    intr_set_level(old_level);
+    if (preempt) {
+        if (intr_context()) {
+            intr_yield_on_return();
+        } else {
+            thread_yield();
+        }
+    }
 }
 
 /* Returns the name of the running thread. */
@@ -312,6 +404,9 @@ thread_exit(void)
      * and schedule another process.  That process will destroy us
      * when it calls thread_schedule_tail(). */
     intr_disable();
+    if (thread_current()->cpu_dirty) {
+        list_remove(&thread_current()->dirtyelem);
+    }
     list_remove(&thread_current()->allelem);
     thread_current()->status = THREAD_DYING;
     schedule();
@@ -330,7 +425,7 @@ thread_yield(void)
 
     old_level = intr_disable();
     if (cur != idle_thread) {
-        list_push_back(&ready_list, &cur->elem);
+        ready_queue_push(cur);
     }
     cur->status = THREAD_READY;
     schedule();
@@ -353,11 +448,82 @@ thread_foreach(thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY and
+ * yields if it no longer has the highest priority.  Priority
+ * donated to the thread is kept until the donating locks are
+ * released.  Has no effect under the 4.4BSD scheduler, which
+ * computes priorities itself. */
 void
 thread_set_priority(int new_priority)
 {
-    thread_current()->priority = new_priority;
+    struct thread *cur = thread_current();
+    enum intr_level old_level;
+
+    ASSERT(PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+    if (thread_mlfqs) {
+        return;
+    }
+
+    old_level = intr_disable();
+    cur->base_priority = new_priority;
+    thread_update_priority(cur);
+    intr_set_level(old_level);
+
+    thread_preempt();
+}
+
+/* Recomputes T's effective priority as the maximum of its base
+ * priority and the priority of every thread waiting on a lock
+ * that T holds.  Called when T releases a lock or changes its
+ * base priority.  Interrupts must be off. */
+void
+thread_update_priority(struct thread *t)
+{
+    int priority = t->base_priority;
+    struct list_elem *le, *we;
+
+    ASSERT(is_thread(t));
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    for (le = list_begin(&t->held_locks); le != list_end(&t->held_locks);
+         le = list_next(le)) {
+        struct list *waiters = &list_entry(le, struct lock, elem)->semaphore.waiters;
+
+        for (we = list_begin(waiters); we != list_end(waiters);
+             we = list_next(we)) {
+            struct thread *waiter = list_entry(we, struct thread, elem);
+            if (waiter->priority > priority) {
+                priority = waiter->priority;
+            }
+        }
+    }
+    set_effective_priority(t, priority);
+}
+
+/* Raises T's effective priority to PRIORITY, if that is higher
+ * than its current one.  Interrupts must be off. */
+void
+thread_donate_priority(struct thread *t, int priority)
+{
+    ASSERT(is_thread(t));
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (priority > t->priority) {
+        set_effective_priority(t, priority);
+    }
+}
+
+/* Orders threads, given their `elem' members, by increasing
+ * effective priority. */
+bool
+thread_priority_less(const struct list_elem *a_, const struct list_elem *b_,
+                     void *aux UNUSED)
+{
+    const struct thread *a = list_entry(a_, struct thread, elem);
+    const struct thread *b = list_entry(b_, struct thread, elem);
+
+    return a->priority < b->priority;
 }
 
 /* Returns the current thread's priority. */
@@ -367,35 +533,137 @@ thread_get_priority(void)
     return thread_current()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, recalculates
+ * its priority, and yields if it no longer has the highest
+ * priority. */
 void
-thread_set_nice(int nice UNUSED)
+thread_set_nice(int nice)
 {
-    /* Not yet implemented. */
+    enum intr_level old_level;
+
+    ASSERT(NICE_MIN <= nice && nice <= NICE_MAX);
+
+    old_level = intr_disable();
+    thread_current()->nice = nice;
+    if (thread_mlfqs) {
+        mlfqs_update_priority(thread_current());
+    }
+    intr_set_level(old_level);
+
+    thread_preempt();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice(void)
 {
-    /* Not yet implemented. */
-    return 0;
+    return thread_current()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg(void)
 {
-    /* Not yet implemented. */
-    return 0;
+    enum intr_level old_level = intr_disable();
+    int load = fix_round(fix_mul_int(load_avg, 100));
+
+    intr_set_level(old_level);
+    return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu(void)
 {
-    /* Not yet implemented. */
-    return 0;
+    enum intr_level old_level = intr_disable();
+    int recent = fix_round(fix_mul_int(thread_current()->recent_cpu, 100));
+
+    intr_set_level(old_level);
+    return recent;
+}
+
+/* Per-tick work of the 4.4BSD scheduler, with CUR the running
+ * thread.  Runs in the timer interrupt.
+ *
+ * Each tick, CUR is charged one tick of recent_cpu and marked
+ * dirty.  Once per second, the load average and every thread's
+ * recent_cpu are recomputed, which changes every priority.
+ * Otherwise, every PRI_RECALC_TICKS ticks, only the priorities of
+ * the dirty threads are recomputed, so the cost of a
+ * recalculation depends on how many threads ran, not on how
+ * many exist. */
+static void
+mlfqs_tick(struct thread *cur)
+{
+    int64_t ticks = timer_ticks();
+
+    if (cur != idle_thread) {
+        cur->recent_cpu = fix_add_int(cur->recent_cpu, 1);
+        if (!cur->cpu_dirty) {
+            cur->cpu_dirty = true;
+            list_push_back(&dirty_list, &cur->dirtyelem);
+        }
+    }
+
+    if (ticks % TIMER_FREQ == 0) {
+        int ready_threads = ready_count + (cur != idle_thread ? 1 : 0);
+
+        load_avg = fix_add(fix_mul(fix_div_int(fix_int(59), 60), load_avg),
+                           fix_div_int(fix_int(ready_threads), 60));
+        thread_foreach(mlfqs_decay, NULL);
+        while (!list_empty(&dirty_list)) {
+            list_entry(list_pop_front(&dirty_list),
+                       struct thread, dirtyelem)->cpu_dirty = false;
+        }
+        thread_preempt();
+    } else if (ticks % PRI_RECALC_TICKS == 0) {
+        while (!list_empty(&dirty_list)) {
+            struct thread *t = list_entry(list_pop_front(&dirty_list),
+                                          struct thread, dirtyelem);
+            t->cpu_dirty = false;
+            mlfqs_update_priority(t);
+        }
+        thread_preempt();
+    }
+}
+
+/* Decays T's recent_cpu by the load average and recalculates its
+ * priority.  Called once per second for every thread. */
+static void
+mlfqs_decay(struct thread *t, void *aux UNUSED)
+{
+    fixed_t twice_load = fix_mul_int(load_avg, 2);
+
+    if (t == idle_thread) {
+        return;
+    }
+    t->recent_cpu = fix_add_int(fix_mul(fix_div(twice_load,
+                                                fix_add_int(twice_load, 1)),
+                                        t->recent_cpu),
+                                t->nice);
+    mlfqs_update_priority(t);
+}
+
+/* Recomputes T's priority from its recent_cpu and niceness as
+ *
+ *      priority = PRI_MAX - (recent_cpu / 4) - (nice * 2),
+ *
+ * clamped to PRI_MIN...PRI_MAX.  Interrupts must be off. */
+static void
+mlfqs_update_priority(struct thread *t)
+{
+    int priority = PRI_MAX - fix_trunc(fix_div_int(t->recent_cpu, 4))
+                   - t->nice * 2;
+
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    if (priority < PRI_MIN) {
+        priority = PRI_MIN;
+    } else if (priority > PRI_MAX) {
+        priority = PRI_MAX;
+    }
+    t->base_priority = priority;
+    set_effective_priority(t, priority);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -405,8 +673,8 @@ thread_get_recent_cpu(void)
  * point it initializes idle_thread, "up"s the semaphore passed
  * to it to enable thread_start() to continue, and immediately
  * blocks.  After that, the idle thread never appears in the
- * ready list.  It is returned by next_thread_to_run() as a
- * special case when the ready list is empty. */
+ * run queues.  It is returned by next_thread_to_run() as a
+ * special case when every run queue is empty. */
 static void
 idle(void *idle_started_ UNUSED)
 {
@@ -484,6 +752,14 @@ init_thread(struct thread *t, const char *name, int priority)
     strlcpy(t->name, name, sizeof t->name);
     t->stack = (uint8_t *)t + PGSIZE;
     t->priority = priority;
+    t->base_priority = priority;
+    list_init(&t->held_locks);
+#ifdef USERPROG
+    list_init(&t->children);
+#endif
+#ifdef VM
+    list_init(&t->mappings);
+#endif
     t->magic = THREAD_MAGIC;
 
     old_level = intr_disable();
@@ -504,19 +780,90 @@ alloc_frame(struct thread *t, size_t size)
     return t->stack;
 }
 
+/* Adds T to the back of the run queue for its priority.
+ * Interrupts must be off. */
+static void
+ready_queue_push(struct thread *t)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+
+    list_push_back(&ready_queues[t->priority], &t->elem);
+    ready_mask |= (uint64_t)1 << t->priority;
+    ready_count++;
+}
+
+/* Removes ready thread T from its run queue.  Interrupts must
+ * be off. */
+static void
+ready_queue_remove(struct thread *t)
+{
+    ASSERT(intr_get_level() == INTR_OFF);
+    ASSERT(t->status == THREAD_READY);
+
+    list_remove(&t->elem);
+    if (list_empty(&ready_queues[t->priority])) {
+        ready_mask &= ~((uint64_t)1 << t->priority);
+    }
+    ready_count--;
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+ * matching run queue if it is ready.  Interrupts must be off. */
+static void
+set_effective_priority(struct thread *t, int priority)
+{
+    if (t->priority == priority) {
+        return;
+    }
+    if (t->status == THREAD_READY) {
+        ready_queue_remove(t);
+        t->priority = priority;
+        ready_queue_push(t);
+    } else {
+        t->priority = priority;
+    }
+}
+
+/* Returns the highest priority that has a ready thread, or -1
+ * if no thread is ready.  Interrupts must be off. */
+static int
+ready_max_priority(void)
+{
+    uint32_t hi = ready_mask >> 32;
+    uint32_t lo = ready_mask;
+
+    if (hi != 0) {
+        return 63 - __builtin_clz(hi);
+    } else if (lo != 0) {
+        return 31 - __builtin_clz(lo);
+    } else {
+        return -1;
+    }
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
- * return a thread from the run queue, unless the run queue is
- * empty.  (If the running thread can continue running, then it
- * will be in the run queue.)  If the run queue is empty, return
- * idle_thread. */
+ * return a thread from the highest-priority non-empty run
+ * queue, unless every run queue is empty.  (If the running
+ * thread can continue running, then it will be in a run queue.)
+ * If every run queue is empty, return idle_thread. */
 static struct thread *
 next_thread_to_run(void)
 {
-    if (list_empty(&ready_list)) {
+    int priority = ready_max_priority();
+    struct list *queue;
+    struct thread *t;
+
+    if (priority < 0) {
         return idle_thread;
-    } else {
-        return list_entry(list_pop_front(&ready_list), struct thread, elem);
     }
+
+    queue = &ready_queues[priority];
+    t = list_entry(list_pop_front(queue), struct thread, elem);
+    if (list_empty(queue)) {
+        ready_mask &= ~((uint64_t)1 << priority);
+    }
+    ready_count--;
+    return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -602,19 +949,6 @@ allocate_tid(void)
     return tid;
 }
 
-uint32_t get_thread_tcb(tid_t tid, struct thread** pp_thread){
-    struct list_elem *e;
-
-    for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e)){
-        *pp_thread = list_entry (e, struct thread, allelem);
-        //printf("HERE tid = %u %u\n", (*pp_thread)->tid, tid);
-        if((*pp_thread)->tid == tid){
-            return 1;
-        }
-    }
-    return -1;
-}
-
 /* Offset of `stack' member within `struct thread'.
  * Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof(struct thread, stack);
@@ -2,10 +2,12 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 
 #include "synch.h"
+#include "threads/fixed-point.h"
 #include "userprog/process.h"
 
 /* States in a thread's life cycle. */
@@ -26,6 +28,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX     63 /* Highest priority. */
 
+/* Thread niceness, used by the 4.4BSD scheduler. */
+#define NICE_MIN     -20 /* Nicest: gives up the most CPU time. */
+#define NICE_DEFAULT 0   /* Default niceness. */
+#define NICE_MAX     20  /* Least nice. */
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -76,12 +83,13 @@ typedef int tid_t;
  * the `magic' member of the running thread's `struct thread' is
  * set to THREAD_MAGIC.  Stack overflow will normally change this
  * value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+/* The `elem' member has a triple purpose.  It can be an element in
+ * the run queue (thread.c), an element in a semaphore wait list
+ * (synch.c), or an element in the timer's sleep list
+ * (devices/timer.c).  It can be used these ways only because they
+ * are mutually exclusive: only a thread in the ready state is on
+ * the run queue, whereas a blocked thread waits either on a
+ * semaphore or on the sleep list, never both. */
 struct thread {
     /* Owned by thread.c. */
     tid_t              tid;      /* Thread identifier. */
@@ -91,35 +99,53 @@ struct thread {
     int                priority; /* Priority. */
     struct list_elem   allelem;  /* List element for all threads list. */
 
-    /* Shared between thread.c and synch.c. */
+    /* Priority donation, shared between thread.c and synch.c.
+     * `priority' above is the effective priority: the larger of
+     * `base_priority' and the priorities of all threads waiting
+     * on locks in `held_locks'. */
+    int           base_priority; /* Priority before donation. */
+    struct list   held_locks;    /* Locks held by this thread. */
+    struct lock  *waiting_lock;  /* Lock being waited for, or NULL. */
+
+    /* 4.4BSD scheduler state, used only if thread_mlfqs. */
+    int              nice;       /* Niceness. */
+    fixed_t          recent_cpu; /* Recent CPU time received. */
+    bool             cpu_dirty;  /* On dirty_list: recent_cpu changed. */
+    struct list_elem dirtyelem;  /* List element for dirty_list. */
+
+    /* Shared between thread.c, synch.c and devices/timer.c. */
     struct list_elem elem; /* List element. */
 
+    /* Owned by devices/timer.c. */
+    int64_t wakeup_tick; /* Tick at which a sleeping thread wakes. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir; /* Page directory. */
 
-    int exit_status;            //Holds exit status of a thread as a child so my parent can reap it'
-
-    //Flag variables which signal special events
-    bool completed_executing;   //Signals are process has already called sys_exit and might be waiting
-    bool already_waiting;       //Signals someone has already called wait on the tid
+    int exit_status;            //Holds exit status of a thread until process_exit() publishes it
 
     struct file* file_executable; //The file which is associate with this thread executable
 
-    //Semaphores between myself and parent
-    struct semaphore myself_wait_for_parent_exit;
-    struct semaphore parent_wait_for_my_exit;
+    struct child_status *child_status; //Shared with my parent, NULL if nobody can wait for me
+    struct list children;              //struct child_status of each child I may still wait for
 
-    //Semaphores between myself and children
-    struct semaphore myself_wait_for_child_exit;
-    struct semaphore child_wait_for_my_exit;
+    process_control_block pcb;
+#endif
 
-    //Blocking the parent user process for child to register
-    struct semaphore exec_wait_on_child_register;
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash *pages; /* Supplemental page table, or null. */
+    void *user_esp;     /* User stack pointer on the last system call. */
 
-    process_control_block pcb;
+    /* Owned by vm/mmap.c. */
+    struct list mappings; /* Memory-mapped files. */
+    int next_mapid;       /* Identifier for the next mapping. */
+#endif
 
-    
+#ifdef FILESYS
+    /* Owned by filesys/filesys.c. */
+    struct dir *cwd; /* Working directory, or null for the root. */
 #endif
 
     /* Owned by thread.c. */
@@ -135,6 +161,7 @@ void thread_init(void);
 void thread_start(void);
 void thread_tick(void);
 void thread_print_stats(void);
+int64_t thread_get_idle_ticks(void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create(const char *name, int priority, thread_func *, void *);
@@ -146,6 +173,11 @@ tid_t thread_tid(void);
 const char *thread_name(void);
 void thread_exit(void) NO_RETURN;
 void thread_yield(void);
+void thread_preempt(void);
+void thread_update_priority(struct thread *);
+void thread_donate_priority(struct thread *, int priority);
+bool thread_priority_less(const struct list_elem *,
+                          const struct list_elem *, void *aux);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -158,7 +190,4 @@ void thread_set_nice(int);
 int thread_get_recent_cpu(void);
 int thread_get_load_avg(void);
 
-/* Returns tcb based upon tid */
-uint32_t get_thread_tcb(tid_t tid, struct thread** pp_thread);
-
 #endif /* threads/thread.h */
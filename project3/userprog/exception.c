@@ -5,6 +5,9 @@
 #include "threads/thread.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -145,6 +148,25 @@ page_fault(struct intr_frame *f)
     write = (f->error_code & PF_W) != 0;
     user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+    /* Bring in a page that has not been loaded yet, or grow the
+     * stack.  This applies to faults in the kernel too, which
+     * touches user buffers directly during system calls; the user
+     * stack pointer is then the one saved on entry. */
+    if (not_present
+        && (page_load(fault_addr, write)
+            || page_grow_stack(fault_addr, user ? f->esp
+                                            : thread_current()->user_esp))) {
+        return;
+    }
+
+    /* Give a process its own copy of a page it shares with a
+     * forked process when it first writes to it. */
+    if (!not_present && write && page_unshare(fault_addr)) {
+        return;
+    }
+#endif
+
     // THL - Page Fault for bad pointer
     if(!user){
         f->eip = f->eax;
@@ -0,0 +1,148 @@
+#include "userprog/fd-table.h"
+#include <debug.h>
+#include <string.h>
+
+#include "filesys/file.h"
+#include "threads/malloc.h"
+
+static bool grow(struct fd_table *);
+
+/* Initializes T as an empty table using its inline storage. */
+void
+fd_table_init(struct fd_table *t)
+{
+    t->files = t->inline_files;
+    t->free = t->inline_free;
+    t->free_cnt = 0;
+    t->used = 0;
+    t->capacity = FD_INLINE_CNT;
+}
+
+/* Stores FILE in T under a free descriptor, preferring one that
+ * was closed earlier, and returns that descriptor, or -1 if
+ * memory is exhausted. */
+int
+fd_table_add(struct fd_table *t, struct file *file)
+{
+    int slot;
+
+    ASSERT(file != NULL);
+
+    if (t->free_cnt > 0) {
+        slot = t->free[--t->free_cnt];
+    } else {
+        if (t->used == t->capacity && !grow(t)) {
+            return -1;
+        }
+        slot = t->used++;
+    }
+    t->files[slot] = file;
+    return slot + FD_MIN;
+}
+
+/* Returns the file open as FD in T, or NULL if FD is not open. */
+struct file *
+fd_table_get(const struct fd_table *t, int fd)
+{
+    int slot = fd - FD_MIN;
+
+    if (slot < 0 || slot >= t->used) {
+        return NULL;
+    }
+    return t->files[slot];
+}
+
+/* Removes FD from T and returns the file that was open as FD,
+ * which the caller must close, or NULL if FD was not open. */
+struct file *
+fd_table_remove(struct fd_table *t, int fd)
+{
+    struct file *file = fd_table_get(t, fd);
+
+    if (file != NULL) {
+        int slot = fd - FD_MIN;
+        t->files[slot] = NULL;
+        t->free[t->free_cnt++] = slot;
+    }
+    return file;
+}
+
+/* Fills DST, which must be empty, with new handles on the files
+ * open in SRC, under the same descriptors and at the same
+ * positions.  Returns true if successful, false if memory is
+ * exhausted, in which case DST holds some of the files and must
+ * still be destroyed. */
+bool
+fd_table_copy(struct fd_table *dst, const struct fd_table *src)
+{
+    int slot;
+
+    ASSERT(dst->used == 0);
+
+    while (dst->capacity < src->used) {
+        if (!grow(dst)) {
+            return false;
+        }
+    }
+    for (slot = 0; slot < src->used; slot++) {
+        struct file *file = src->files[slot];
+
+        if (file != NULL) {
+            file = file_reopen(file);
+            if (file == NULL) {
+                return false;
+            }
+            file_seek(file, file_tell(src->files[slot]));
+        }
+        dst->files[slot] = file;
+        dst->used = slot + 1;
+    }
+    memcpy(dst->free, src->free, src->free_cnt * sizeof *dst->free);
+    dst->free_cnt = src->free_cnt;
+    return true;
+}
+
+/* Closes every file open in T and frees T's heap storage.  T
+ * must be reinitialized before it is used again. */
+void
+fd_table_destroy(struct fd_table *t)
+{
+    int slot;
+
+    for (slot = 0; slot < t->used; slot++) {
+        if (t->files[slot] != NULL) {
+            file_close(t->files[slot]);
+        }
+    }
+    if (t->files != t->inline_files) {
+        free(t->files);
+        free(t->free);
+    }
+    fd_table_init(t);
+}
+
+/* Doubles T's capacity.  Returns true if successful, false if
+ * memory is exhausted. */
+static bool
+grow(struct fd_table *t)
+{
+    int capacity = t->capacity * 2;
+    struct file **files = malloc(capacity * sizeof *files);
+    int *free_slots = malloc(capacity * sizeof *free_slots);
+
+    if (files == NULL || free_slots == NULL) {
+        free(files);
+        free(free_slots);
+        return false;
+    }
+    memcpy(files, t->files, t->used * sizeof *files);
+    memcpy(free_slots, t->free, t->free_cnt * sizeof *free_slots);
+    if (t->files != t->inline_files) {
+        free(t->files);
+        free(t->free);
+    }
+    t->files = files;
+    t->free = free_slots;
+    t->capacity = capacity;
+    return true;
+}
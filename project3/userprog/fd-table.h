@@ -0,0 +1,41 @@
+#ifndef USERPROG_FD_TABLE_H
+#define USERPROG_FD_TABLE_H
+
+#include <stdbool.h>
+
+struct file;
+
+/* File descriptors 0 and 1 are the console; the table hands out
+ * descriptors starting at FD_MIN. */
+#define FD_MIN 2
+
+/* Number of descriptors stored inside the table itself.  Most
+ * processes never open more files than this; those that do spill
+ * into heap storage that doubles in size as needed. */
+#define FD_INLINE_CNT 8
+
+/* A process's open files, indexed by file descriptor.
+ *
+ * Descriptors freed by fd_table_remove() are pushed on a stack of
+ * free slots and handed out again by fd_table_add() before any
+ * never-used slot, so opening and closing are O(1), apart from
+ * the occasional doubling of the table. */
+struct fd_table {
+    struct file **files;    /* files[fd - FD_MIN], or NULL if closed. */
+    int          *free;     /* Stack of closed slot indexes. */
+    int           free_cnt; /* Number of entries on FREE. */
+    int           used;     /* Slots ever handed out. */
+    int           capacity; /* Number of slots in FILES and FREE. */
+
+    struct file  *inline_files[FD_INLINE_CNT]; /* Initial FILES. */
+    int           inline_free[FD_INLINE_CNT];  /* Initial FREE. */
+};
+
+void fd_table_init(struct fd_table *);
+int fd_table_add(struct fd_table *, struct file *);
+struct file *fd_table_get(const struct fd_table *, int fd);
+struct file *fd_table_remove(struct fd_table *, int fd);
+bool fd_table_copy(struct fd_table *dst, const struct fd_table *src);
+void fd_table_destroy(struct fd_table *);
+
+#endif /* userprog/fd-table.h */
@@ -189,6 +189,24 @@ pagedir_set_dirty(uint32_t *pd, const void *vpage, bool dirty)
     }
 }
 
+/* Makes the present PTE for virtual page VPAGE in PD writable if
+ * WRITABLE is true, read-only otherwise, keeping its accessed and
+ * dirty bits.  Does nothing if VPAGE is not mapped in PD. */
+void
+pagedir_set_writable(uint32_t *pd, const void *vpage, bool writable)
+{
+    uint32_t *pte = lookup_page(pd, vpage, false);
+
+    if (pte != NULL && (*pte & PTE_P) != 0) {
+        if (writable) {
+            *pte |= PTE_W;
+        } else {
+            *pte &= ~(uint32_t)PTE_W;
+        }
+        invalidate_pagedir(pd);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD has been
  * accessed recently, that is, between the time the PTE was
  * installed and the last time it was cleared.  Returns false if
@@ -11,6 +11,7 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
@@ -19,6 +20,10 @@
 #include "userprog/process.h"
 #include "userprog/tss.h"
 #include "filesys/file.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 #define LOGGING_LEVEL 6
 
@@ -29,27 +34,42 @@ typedef struct cmd_token_info{
     uint32_t number_chars;
     char token_array[512];
     uint32_t token_index[512];
+    struct child_status *status; //Record shared between the new process and its parent
+    struct dir *cwd;             //Parent's working directory, reopened for the child
 } cmd_token_info;
 
+#ifdef VM
+typedef struct fork_info{
+    struct thread *parent;
+    const struct intr_frame *if_; //Parent's user context, resumed in the child with eax = 0
+    struct child_status *status;  //Record shared between the new process and its parent
+} fork_info;
+
+static thread_func start_fork NO_RETURN;
+static bool fork_address_space(struct thread *parent);
+#endif
+
 static thread_func start_process NO_RETURN;
+static struct child_status *child_status_create(void);
+static void child_status_release(struct child_status *cs);
 static bool load(const cmd_token_info *cur_cmd_info, void(**eip) (void), void **esp);
 
 /* Starts a new thread running a user program loaded from
  * FILENAME.  The new thread may be scheduled (and may even exit)
- * before process_execute() returns.  Returns the new process's
- * thread id, or TID_ERROR if the thread cannot be created. */
+ * before process_execute() returns.  Waits for the new process to
+ * finish loading, then returns its thread id, or TID_ERROR if the
+ * thread cannot be created or the program cannot be loaded. */
 tid_t
 process_execute(const char *cmd_string)
 {
     tid_t tid;
-    tid_t parent_tid = thread_current()->tid;
+    struct child_status *cs;
 
     cmd_token_info* cur_cmd_info;
     char current_char = cmd_string[0];
     char previous_char = (char) 0;
     uint32_t char_count = 0;
     uint32_t token_count = 1;
-    struct thread *child_thread;
 
     // NOTE:
     // To see this print, make sure LOGGING_LEVEL in this file is <= L_TRACE (6)
@@ -64,6 +84,24 @@ process_execute(const char *cmd_string)
         return TID_ERROR;
     }
 
+    //Shared exit status record: one reference for us, one for the child
+    cs = child_status_create();
+    if (cs == NULL) {
+        palloc_free_page(cur_cmd_info);
+        return TID_ERROR;
+    }
+    cur_cmd_info->status = cs;
+
+    //The child starts out in our working directory
+    if (thread_current()->cwd != NULL) {
+        cur_cmd_info->cwd = dir_reopen(thread_current()->cwd);
+        if (cur_cmd_info->cwd == NULL) {
+            free(cs);
+            palloc_free_page(cur_cmd_info);
+            return TID_ERROR;
+        }
+    }
+
     // THL - Parse the string and tokenize it
     while(current_char != 0x00){ 
         current_char = cmd_string[char_count];
@@ -88,11 +126,21 @@ process_execute(const char *cmd_string)
     /* Create a new thread to execute FILE_NAME. */
     tid = thread_create(&cur_cmd_info->token_array[0], PRI_DEFAULT, start_process, cur_cmd_info);
     if (tid == TID_ERROR) {
+        dir_close(cur_cmd_info->cwd);
         palloc_free_page(cur_cmd_info);
+        free(cs);
+        return TID_ERROR;
+    }
+    cs->tid = tid;
+    list_push_back(&thread_current()->children, &cs->elem);
+
+    //Wait for the child to tell us whether it loaded
+    sema_down(&cs->loaded);
+    if (!cs->load_success) {
+        list_remove(&cs->elem);
+        child_status_release(cs);
+        return TID_ERROR;
     }
-    get_thread_tcb(tid, &child_thread);
-    child_thread->pcb.parent_tid = parent_tid;
-
     return tid;
 }
 
@@ -101,39 +149,34 @@ process_execute(const char *cmd_string)
 static void
 start_process(void *cur_cmd_info)
 {
+    cmd_token_info *info = cur_cmd_info;
     struct thread *cur = thread_current();
-    struct thread *par;
 
     struct intr_frame if_;
     bool success;
 
     log(L_TRACE, "start_process()");
 
+    //Until exit() says otherwise we were killed
+    cur->child_status = info->status;
+    cur->exit_status = -1;
+    cur->cwd = info->cwd;
+    fd_table_init(&cur->pcb.fds);
+
     /* Initialize interrupt frame and load executable. */
     memset(&if_, 0, sizeof if_);
     if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
     if_.cs = SEL_UCSEG;
     if_.eflags = FLAG_IF | FLAG_MBS;
     success = load(cur_cmd_info, &if_.eip, &if_.esp);
-    /* If load failed, quit. */
+    /* Tell the parent how the load went.  If it failed, quit. */
     palloc_free_page(cur_cmd_info);
+    cur->child_status->load_success = success;
+    sema_up(&cur->child_status->loaded);
     if (!success) {
-        //printf("Error in starting process\n");
-        //Clear the parent semaphore because we didn't load right
-        if(thread_current()->pcb.parent_tid != 1){
-            get_thread_tcb(thread_current()->pcb.parent_tid, &par);
-            par->pcb.child_exec_fail = 1;
-            sema_up(&(par->exec_wait_on_child_register));
-        } 
         thread_exit();
     }
 
-    if(thread_current()->pcb.parent_tid != 1){
-        get_thread_tcb(thread_current()->pcb.parent_tid, &par);
-        par->pcb.child_exec_fail = 0;
-        sema_up(&(par->exec_wait_on_child_register));
-    } 
-
     /* Start the user process by simulating a return from an
      * interrupt, implemented by intr_exit (in
      * threads/intr-stubs.S).  Because intr_exit takes all of its
@@ -144,6 +187,109 @@ start_process(void *cur_cmd_info)
     NOT_REACHED();
 }
 
+#ifdef VM
+/* Starts a new process that is a copy of the running one, which
+ * entered the kernel with user context IF_.  The copy shares the
+ * running process's memory copy-on-write and has its own handles
+ * on the same files, and resumes at the same point as if fork()
+ * had returned 0.  Returns the new process's thread id, or
+ * TID_ERROR if it cannot be created. */
+tid_t
+process_fork(const struct intr_frame *if_)
+{
+    struct thread *cur = thread_current();
+    fork_info info;
+    tid_t tid;
+
+    info.parent = cur;
+    info.if_ = if_;
+    info.status = child_status_create();
+    if (info.status == NULL) {
+        return TID_ERROR;
+    }
+
+    tid = thread_create(cur->name, PRI_DEFAULT, start_fork, &info);
+    if (tid == TID_ERROR) {
+        free(info.status);
+        return TID_ERROR;
+    }
+    info.status->tid = tid;
+    list_push_back(&cur->children, &info.status->elem);
+
+    //Wait for the child to finish copying us: until then it reads our state
+    sema_down(&info.status->loaded);
+    if (!info.status->load_success) {
+        list_remove(&info.status->elem);
+        child_status_release(info.status);
+        return TID_ERROR;
+    }
+    return tid;
+}
+
+/* A thread function that copies the parent's address space and
+ * open files and starts the copy running. */
+static void
+start_fork(void *info_)
+{
+    fork_info *info = info_;
+    struct thread *cur = thread_current();
+    struct thread *parent = info->parent;
+    struct intr_frame if_ = *info->if_;
+    bool success;
+
+    //Until exit() says otherwise we were killed
+    cur->child_status = info->status;
+    cur->exit_status = -1;
+    fd_table_init(&cur->pcb.fds);
+
+    success = fork_address_space(parent)
+              && fd_table_copy(&cur->pcb.fds, &parent->pcb.fds);
+    if (success && parent->cwd != NULL) {
+        cur->cwd = dir_reopen(parent->cwd);
+        success = cur->cwd != NULL;
+    }
+
+    //INFO lives on the parent's stack, so this is the last we see of it
+    cur->child_status->load_success = success;
+    sema_up(&cur->child_status->loaded);
+    if (!success) {
+        fd_table_destroy(&cur->pcb.fds);
+        thread_exit();
+    }
+
+    if_.eax = 0;
+    asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+    NOT_REACHED();
+}
+
+/* Gives the running process a page directory and supplemental
+ * page table that share PARENT's memory, copies of PARENT's
+ * mappings and its own handle on PARENT's executable.  Returns
+ * false if memory is exhausted; process_exit() cleans up. */
+static bool
+fork_address_space(struct thread *parent)
+{
+    struct thread *t = thread_current();
+
+    if (!page_table_create()) {
+        return false;
+    }
+    t->pagedir = pagedir_create();
+    if (t->pagedir == NULL) {
+        return false;
+    }
+    process_activate();
+
+    t->file_executable = file_reopen(parent->file_executable);
+    if (t->file_executable == NULL) {
+        return false;
+    }
+    file_deny_write(t->file_executable);
+
+    return mmap_fork(parent) && page_table_fork(parent);
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
  * it was terminated by the kernel (i.e. killed due to an
  * exception), returns -1.  If TID is invalid or if it was not a
@@ -151,28 +297,64 @@ start_process(void *cur_cmd_info)
  * been successfully called for the given TID, returns -1
  * immediately, without waiting.
  *
- * This function will be implemented in problem 2-2.  For now, it
- * does nothing. */
+ * Only the child's status record is consulted, so this works the
+ * same whether the child is still running or long gone. */
 int
-process_wait(tid_t child_tid UNUSED)
+process_wait(tid_t child_tid)
 {
-    uint32_t exit_status;
-
-    // THL - Block on the semaphore associated with tid
-    struct thread* child_tcb = NULL;
-    if(get_thread_tcb(child_tid, &child_tcb) != 1){
-        return -1;
+    struct thread *cur = thread_current();
+    struct list_elem *e;
+    int exit_status;
+
+    for (e = list_begin(&cur->children); e != list_end(&cur->children); e = list_next(e)) {
+        struct child_status *cs = list_entry(e, struct child_status, elem);
+        if (cs->tid == child_tid) {
+            //Block until the child publishes its exit status
+            sema_down(&cs->exited);
+            exit_status = cs->exit_status;
+
+            //A child can only be waited for once
+            list_remove(&cs->elem);
+            child_status_release(cs);
+            return exit_status;
+        }
     }
+    return -1;
+}
 
-    //Block until child tells us he have the exit status!
-    sema_down(&child_tcb->parent_wait_for_my_exit);
+/* Allocates the exit status record shared by a new child and its
+ * parent, with one reference for each.  Returns a null pointer if
+ * memory is exhausted. */
+static struct child_status *
+child_status_create(void)
+{
+    struct child_status *cs = malloc(sizeof *cs);
+
+    if (cs != NULL) {
+        cs->exit_status = -1;
+        cs->load_success = false;
+        sema_init(&cs->loaded, 0);
+        sema_init(&cs->exited, 0);
+        cs->ref_cnt = 2;
+    }
+    return cs;
+}
 
-    exit_status = child_tcb->exit_status;
-    //We got the exit status. Child can not cleanup
-    sema_up(&child_tcb->myself_wait_for_parent_exit);
+/* Drops one reference to CS, freeing it once both the parent and
+ * the child are done with it. */
+static void
+child_status_release(struct child_status *cs)
+{
+    enum intr_level old_level;
+    int ref_cnt;
 
-    return exit_status;
+    old_level = intr_disable();
+    ref_cnt = --cs->ref_cnt;
+    intr_set_level(old_level);
 
+    if (ref_cnt == 0) {
+        free(cs);
+    }
 }
 
 /* Free the current process's resources. */
@@ -182,6 +364,37 @@ process_exit(void)
     struct thread *cur = thread_current();
     uint32_t *pd;
 
+#ifdef VM
+    /* Write back and release our mappings, frames and swap slots
+     * while the page directory and the files behind them are
+     * still around. */
+    mmap_unmap_all();
+    page_table_destroy();
+#endif
+
+    if (cur->file_executable != NULL) {
+        file_allow_write(cur->file_executable);
+        file_close(cur->file_executable);
+        cur->file_executable = NULL;
+    }
+
+    dir_close(cur->cwd);
+    cur->cwd = NULL;
+
+    //Publish our exit status to the parent, if it can still wait for us
+    if (cur->child_status != NULL) {
+        cur->child_status->exit_status = cur->exit_status;
+        sema_up(&cur->child_status->exited);
+        child_status_release(cur->child_status);
+        cur->child_status = NULL;
+    }
+
+    //Our children can no longer be waited for
+    while (!list_empty(&cur->children)) {
+        struct list_elem *e = list_pop_front(&cur->children);
+        child_status_release(list_entry(e, struct child_status, elem));
+    }
+
     /* Destroy the current process's page directory and switch back
      * to the kernel-only page directory. */
     pd = cur->pagedir;
@@ -296,6 +509,13 @@ load(const cmd_token_info *cur_cmd_info, void(**eip) (void), void **esp)
     bool success = false;
     int i;
 
+#ifdef VM
+    /* Allocate the supplemental page table. */
+    if (!page_table_create()) {
+        goto done;
+    }
+#endif
+
     /* Allocate and activate page directory. */
     t->pagedir = pagedir_create();
     if (t->pagedir == NULL) {
@@ -392,13 +612,17 @@ load(const cmd_token_info *cur_cmd_info, void(**eip) (void), void **esp)
 
 done:
     /* We arrive here whether the load is successful or not. */
-    //file_close(file);
+    if (!success) {
+        file_close(file);
+    }
     return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page(void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
  * FILE and returns true if so, false otherwise. */
@@ -465,6 +689,11 @@ validate_segment(const struct Elf32_Phdr *phdr, struct file *file)
  * The pages initialized by this function must be writable by the
  * user process if WRITABLE is true, read-only otherwise.
  *
+ * With VM, nothing is read here: each page is recorded in the
+ * supplemental page table and page_fault() loads it from FILE
+ * the first time it is touched.  Read-only pages share their
+ * frames with every other process running the same executable.
+ *
  * Return true if successful, false if a memory allocation error
  * or disk read error occurs. */
 static bool
@@ -477,6 +706,24 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 
     log(L_TRACE, "load_segment()");
 
+#ifdef VM
+    while (read_bytes > 0 || zero_bytes > 0) {
+        size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+        size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+        if (!page_add_file(upage, page_read_bytes > 0 ? file : NULL, ofs,
+                           page_read_bytes, writable)) {
+            return false;
+        }
+
+        /* Advance. */
+        read_bytes -= page_read_bytes;
+        zero_bytes -= page_zero_bytes;
+        ofs += page_read_bytes;
+        upage += PGSIZE;
+    }
+    return true;
+#else
     file_seek(file, ofs);
     while (read_bytes > 0 || zero_bytes > 0) {
         /* Calculate how to fill this page.
@@ -510,6 +757,7 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
         upage += PGSIZE;
     }
     return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -523,10 +771,20 @@ setup_stack(void **esp, const cmd_token_info *cur_cmd_info)
 
     log(L_TRACE, "setup_stack()");
 
+#ifdef VM
+    /* The stack page comes from the frame table, so that it can be
+     * swapped out like any other.  The arguments are copied in
+     * through its user address. */
+    kpage = ((uint8_t *)PHYS_BASE) - PGSIZE;
+    if (page_add_file(kpage, NULL, 0, 0, true)) {
+        success = page_load(kpage, true);
+        if (success) {
+#else
     kpage = palloc_get_page(PAL_USER | PAL_ZERO);
     if (kpage != NULL) {
         success = install_page(((uint8_t *)PHYS_BASE) - PGSIZE, kpage, true);
         if (success) {
+#endif
             *esp = PHYS_BASE;
             argv_ptr = (uint32_t) *esp;
             // THL - Code to populate stack goes here
@@ -555,13 +813,16 @@ setup_stack(void **esp, const cmd_token_info *cur_cmd_info)
             *((uint32_t*) *esp) = 0;
 
         } else {
+#ifndef VM
             palloc_free_page(kpage);
+#endif
         }
         // hex_dump( *(int*)esp, *esp, 128, true ); // NOTE: uncomment this to check arg passing
     }
     return success;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
  * virtual address KPAGE to the page table.
  * If WRITABLE is true, the user process may modify the page;
@@ -581,3 +842,4 @@ install_page(void *upage, void *kpage, bool writable)
     return pagedir_get_page(t->pagedir, upage) == NULL
            && pagedir_set_page(t->pagedir, upage, kpage, writable);
 }
+#endif
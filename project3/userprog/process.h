@@ -1,26 +1,43 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
-#include "threads/thread.h"
+#include <list.h>
+#include <stdbool.h>
 
-#define MAX_NUMBER_OF_FILES_IN_PROCESS 50
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/fd-table.h"
 
 typedef int tid_t;
 
-
+struct intr_frame;
+
+/* Exit status of a child process.  Owned jointly by the child and
+ * its parent and freed by whichever of the two lets go last, so
+ * a child's struct thread and page directory can be freed as soon
+ * as it exits, whether or not its parent ever waits for it. */
+struct child_status {
+    tid_t            tid;          /* Child's thread id. */
+    int              exit_status;  /* Status passed to exit(). */
+    bool             load_success; /* Whether the executable loaded. */
+    struct semaphore loaded;       /* Upped once the load finishes. */
+    struct semaphore exited;       /* Upped when the child exits. */
+    int              ref_cnt;      /* Number of owners, at most 2. */
+    struct list_elem elem;         /* Element in parent's children. */
+};
 
 typedef struct process_control_block{
     tid_t tid;
-    tid_t parent_tid;
-    int child_exec_fail;
 
-    //Will contain the number of open files. 0 will mean that index 0 1 are used (stdin/out)
-    struct file* file_descriptor_table[MAX_NUMBER_OF_FILES_IN_PROCESS];
-    int number_open_files;
+    //Open files by descriptor. 0 and 1 are stdin/out and never in the table
+    struct fd_table fds;
 } process_control_block;
 
 tid_t process_execute(const char *file_name);
 int process_wait(tid_t);
+#ifdef VM
+tid_t process_fork(const struct intr_frame *);
+#endif
 void process_exit(void);
 void process_activate(void);
 
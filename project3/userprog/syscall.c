@@ -1,14 +1,23 @@
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "userprog/syscall.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#endif
 
 #define DEBUG 1
 
@@ -19,121 +28,216 @@
 #endif
 
 //Wait Exec and Exit Rules:
-//Children can NOT exit if parent is alive and waiting
-//Assuming that sys_calls are atomic by nature. Other threads can't all INT 30
+//A child and its parent share a refcounted struct child_status (see process.h)
+//Children never wait for their parent: exit frees the thread right away and
+//the parent reads the status from the record, even after the child is gone
+
+//File system calls take no lock here: each inode, the open inode list and the
+//free map carry their own locks (see filesys/inode.h and filesys/free-map.c)
+
+//How the dispatcher checks an argument word before the handler sees it
+enum syscall_arg {
+    ARG_INT,    //Plain value
+    ARG_STRING, //User string, replaced by a kernel copy that is freed after the call
+    ARG_BUFFER, //User buffer whose size is the next argument, which must lie below PHYS_BASE
+    ARG_UADDR   //User address the handler only touches through uaccess.c, if at all
+};
+
+//Descriptor for one system call, see the syscalls table below
+struct syscall_desc {
+    const char *name;
+    void (*handler)(const int *args, struct intr_frame *f); //Stores any result in f->eax
+    int arg_cnt;
+    enum syscall_arg args[3];
+    int error; //Result when a string argument does not fit in a page or memory is short
+};
+
+//Layout of struct iovec in lib/user/syscall.h
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+//Most buffers readv/writev take in one call
+#define IOV_MAX 1024
+
+//Returned by read_iov()/write_iov() when a user buffer is bad: the caller frees what it holds, then kills the process
+#define IO_BAD_BUFFER (-2)
+
+//User memory is only touched through userprog/uaccess.c: strings are copied into a kernel page and
+//read/write buffers go through one a page at a time, so the file system never faults on a user address
 
 static void syscall_handler(struct intr_frame *);
-static struct lock file_lock;
-static void aquire_fs_lock(void);
-static void release_fs_lock(void);
-static int valid_pointer(void* provided_pointer);
-static int valid_arg(void* arg_address);
-static int get_user (const uint8_t *uaddr);
-//static bool put_user (uint8_t *udst, uint8_t byte);
+static void get_args(const int *uargs, int *args, size_t cnt);
+static int check_args(const struct syscall_desc *desc, int *args, char **strings);
+static bool copy_in_string(const char *ustr, char **kstr);
+static int vector_io(int fd, const struct iovec *uiov, int iovcnt,
+                     int (*transfer)(int fd, const struct iovec *iov, int iovcnt));
+static int write_iov(int fd, const struct iovec *iov, int iovcnt);
+static int read_iov(int fd, const struct iovec *iov, int iovcnt);
 
 void sys_halt (void);
 void sys_exit(int status);
 int sys_exec (const char *cmd_line);
 int sys_wait(tid_t tid);
-int sys_write (int fd, char *buffer, unsigned size);
+int sys_write (int fd, const void *buffer, unsigned size);
 int sys_open(const char *file);
 bool sys_create(const char *file, unsigned initial_size);
 bool sys_remove(const char *file);
 int sys_read(int fd, void *buffer, unsigned size);
 int sys_filesize(int fd);
+void sys_seek(int fd, unsigned position);
+unsigned sys_tell(int fd);
+void sys_close(int fd);
+bool sys_chdir(const char *dir);
+bool sys_mkdir(const char *dir);
+bool sys_readdir(int fd, char *name);
+bool sys_isdir(int fd);
+int sys_inumber(int fd);
+int sys_readv(int fd, const struct iovec *iov, int iovcnt);
+int sys_writev(int fd, const struct iovec *iov, int iovcnt);
+#ifdef VM
+int sys_mmap(int fd, void *addr);
+void sys_munmap(int mapping);
+int sys_fork(struct intr_frame *f);
+#endif
+
+//Adapters from the argument words to each handler's own signature
+static void call_halt(const int *a UNUSED, struct intr_frame *f UNUSED){ sys_halt(); }
+static void call_exit(const int *a, struct intr_frame *f UNUSED){ sys_exit(a[0]); }
+static void call_exec(const int *a, struct intr_frame *f){ f->eax = sys_exec((const char*) a[0]); }
+static void call_wait(const int *a, struct intr_frame *f){ f->eax = sys_wait((tid_t) a[0]); }
+static void call_create(const int *a, struct intr_frame *f){ f->eax = sys_create((const char*) a[0], (unsigned) a[1]); }
+static void call_remove(const int *a, struct intr_frame *f){ f->eax = sys_remove((const char*) a[0]); }
+static void call_open(const int *a, struct intr_frame *f){ f->eax = sys_open((const char*) a[0]); }
+static void call_filesize(const int *a, struct intr_frame *f){ f->eax = sys_filesize(a[0]); }
+static void call_read(const int *a, struct intr_frame *f){ f->eax = sys_read(a[0], (void*) a[1], (unsigned) a[2]); }
+static void call_write(const int *a, struct intr_frame *f){ f->eax = sys_write(a[0], (const void*) a[1], (unsigned) a[2]); }
+static void call_seek(const int *a, struct intr_frame *f UNUSED){ sys_seek(a[0], (unsigned) a[1]); }
+static void call_tell(const int *a, struct intr_frame *f){ f->eax = sys_tell(a[0]); }
+static void call_close(const int *a, struct intr_frame *f UNUSED){ sys_close(a[0]); }
+static void call_chdir(const int *a, struct intr_frame *f){ f->eax = sys_chdir((const char*) a[0]); }
+static void call_mkdir(const int *a, struct intr_frame *f){ f->eax = sys_mkdir((const char*) a[0]); }
+static void call_readdir(const int *a, struct intr_frame *f){ f->eax = sys_readdir(a[0], (char*) a[1]); }
+static void call_isdir(const int *a, struct intr_frame *f){ f->eax = sys_isdir(a[0]); }
+static void call_inumber(const int *a, struct intr_frame *f){ f->eax = sys_inumber(a[0]); }
+static void call_readv(const int *a, struct intr_frame *f){ f->eax = sys_readv(a[0], (const struct iovec*) a[1], a[2]); }
+static void call_writev(const int *a, struct intr_frame *f){ f->eax = sys_writev(a[0], (const struct iovec*) a[1], a[2]); }
+#ifdef VM
+static void call_mmap(const int *a, struct intr_frame *f){ f->eax = sys_mmap(a[0], (void*) a[1]); }
+static void call_munmap(const int *a, struct intr_frame *f UNUSED){ sys_munmap(a[0]); }
+static void call_fork(const int *a UNUSED, struct intr_frame *f){ f->eax = sys_fork(f); }
+#endif
+
+//Every system call by SYS_* number. Numbers with no entry, such as mmap without VM, fail with -1
+static const struct syscall_desc syscalls[] = {
+    [SYS_HALT]     = {"halt",     call_halt,     0, {ARG_INT},                        0},
+    [SYS_EXIT]     = {"exit",     call_exit,     1, {ARG_INT},                        0},
+    [SYS_EXEC]     = {"exec",     call_exec,     1, {ARG_STRING},                    -1},
+    [SYS_WAIT]     = {"wait",     call_wait,     1, {ARG_INT},                        0},
+    [SYS_CREATE]   = {"create",   call_create,   2, {ARG_STRING, ARG_INT},        false},
+    [SYS_REMOVE]   = {"remove",   call_remove,   1, {ARG_STRING},                 false},
+    [SYS_OPEN]     = {"open",     call_open,     1, {ARG_STRING},                    -1},
+    [SYS_FILESIZE] = {"filesize", call_filesize, 1, {ARG_INT},                        0},
+    [SYS_READ]     = {"read",     call_read,     3, {ARG_INT, ARG_BUFFER, ARG_INT},   0},
+    [SYS_WRITE]    = {"write",    call_write,    3, {ARG_INT, ARG_BUFFER, ARG_INT},   0},
+    [SYS_SEEK]     = {"seek",     call_seek,     2, {ARG_INT, ARG_INT},               0},
+    [SYS_TELL]     = {"tell",     call_tell,     1, {ARG_INT},                        0},
+    [SYS_CLOSE]    = {"close",    call_close,    1, {ARG_INT},                        0},
+    [SYS_CHDIR]    = {"chdir",    call_chdir,    1, {ARG_STRING},                 false},
+    [SYS_MKDIR]    = {"mkdir",    call_mkdir,    1, {ARG_STRING},                 false},
+    [SYS_READDIR]  = {"readdir",  call_readdir,  2, {ARG_INT, ARG_UADDR},             0},
+    [SYS_ISDIR]    = {"isdir",    call_isdir,    1, {ARG_INT},                        0},
+    [SYS_INUMBER]  = {"inumber",  call_inumber,  1, {ARG_INT},                        0},
+#ifdef VM
+    [SYS_MMAP]     = {"mmap",     call_mmap,     2, {ARG_INT, ARG_UADDR},             0},
+    [SYS_MUNMAP]   = {"munmap",   call_munmap,   1, {ARG_INT},                        0},
+    [SYS_FORK]     = {"fork",     call_fork,     0, {ARG_INT},                        0},
+#endif
+    [SYS_READV]    = {"readv",    call_readv,    3, {ARG_INT, ARG_UADDR, ARG_INT},    0},
+    [SYS_WRITEV]   = {"writev",   call_writev,   3, {ARG_INT, ARG_UADDR, ARG_INT},    0},
+};
+#define SYSCALL_CNT ((int) (sizeof syscalls / sizeof *syscalls))
+
+//Calls made and timer ticks spent in each system call, for syscall_print_stats()
+//Updated with interrupts off, since any process may be making the same call
+static struct syscall_stats {
+    long long calls;
+    long long ticks;
+} syscall_stats[SYSCALL_CNT];
 
 void syscall_init(void)
 {
     intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall");
-    lock_init(&file_lock);
 }
 
 static void
-syscall_handler(struct intr_frame *f UNUSED)
+syscall_handler(struct intr_frame *f)
 {
-    
-
-    //Make sure stack pointer is valid
-    if(!valid_pointer(f->esp)){
-         sys_exit(-1);
-    }
-    //Before using the args, will need to check they are all below 0xC0000000
-    uint32_t *usp = f->esp;
-    int call_no = *usp;
-    int arg0 = *(usp+1);
-    int arg1 = *(usp+2);;
-    int arg2 = *(usp+3);;
-    //int arg3 = *(usp+4);;
+#ifdef VM
+    //Page faults taken on our behalf grow the stack relative to the user's esp
+    thread_current()->user_esp = f->esp;
+#endif
+
+    //The call number and arguments are copied in from the user stack, so a bad esp only kills the process
+    const int *usp = f->esp;
+    const struct syscall_desc *desc;
+    struct syscall_stats *stats;
+    int call_no;
+    int args[3];
+    char *strings[3] = {NULL, NULL, NULL};
+    enum intr_level old_level;
+    int64_t start;
+    int status;
+    int i;
+
+    get_args(usp, &call_no, 1);
     //printf("sys_call 0x%X\n", call_no);
+    if(call_no < 0 || call_no >= SYSCALL_CNT || syscalls[call_no].handler == NULL){
+        f->eax = -1;
+        return;
+    }
+    desc = &syscalls[call_no];
+    stats = &syscall_stats[call_no];
+    get_args(usp + 1, args, desc->arg_cnt);
+
+    status = check_args(desc, args, strings);
+    if(status > 0){
+        old_level = intr_disable();
+        stats->calls++;
+        intr_set_level(old_level);
+
+        start = timer_ticks();
+        desc->handler(args, f);
+
+        old_level = intr_disable();
+        stats->ticks += timer_elapsed(start);
+        intr_set_level(old_level);
+    } else if(status == 0){
+        f->eax = desc->error;
+    }
 
-    switch(call_no) {
-        case SYS_HALT:
-            sys_halt();
-            break;
-        case SYS_EXIT:
-            if(!valid_arg(usp+1)){
-                sys_exit(-1);
-            }
-            sys_exit(arg0);
-            break;
-        case SYS_EXEC:
-            if(!valid_pointer((void*) arg0) || !valid_arg((void*) usp+1)){
-                sys_exit(-1);
-            }
-            f->eax = sys_exec((char*) arg0);
-            break;
-        case SYS_WAIT:
-            if(!valid_arg((void*) usp+1)){
-                sys_exit(-1);
-            }
-            f->eax = sys_wait((tid_t) arg0);
-            break;
-        case SYS_CREATE:
-            if(!valid_pointer((void*) arg0) || !valid_arg((void*) usp+2)){
-                sys_exit(-1);
-            }
-            f->eax = sys_create((char *) arg0, (int) arg1);
-            break;
-        case SYS_REMOVE:
-            if(!valid_pointer((void*) arg0) || !valid_arg((void*) usp+1)){
-                sys_exit(-1);
-            }
-            f->eax = sys_remove((char *) arg0);
-            break;
-        case SYS_OPEN:
-            if(!valid_pointer((void*) arg0) || !valid_arg((void*) usp+1)){
-                sys_exit(-1);
-            }
-            f->eax = sys_open((char*) arg0);
-            break;
-        case SYS_FILESIZE:
-            if(!valid_arg((void*) usp+1)){
-                sys_exit(-1);
-            }
-            f->eax = sys_filesize((int) arg0);
-            break;
-        case SYS_READ:
-            if(!valid_pointer((void*) arg1) || !valid_arg((void*) usp+3)){
-                sys_exit(-1);
-            }
-            f->eax = sys_read((int) arg0, (char*) arg1, (unsigned) arg2);
-            break;
-        case SYS_WRITE:
-            if(!valid_pointer((void*) arg1) || !valid_arg((void*) usp+3)){
-                sys_exit(-1);
-            }
-            f->eax = sys_write((int) arg0, (char*) arg1, (unsigned) arg2);
-            break;
-        case SYS_SEEK:
-            if(!valid_arg((void*) usp+2)){
-                sys_exit(-1);
-            }
-            sys_seek((int) arg0, (unsigned) arg1);
-            break;
-        case SYS_TELL:
-            break;
-        case SYS_CLOSE:
-            break;
+    for(i = 0; i < desc->arg_cnt; i++){
+        if(strings[i] != NULL){
+            palloc_free_page(strings[i]);
+        }
+    }
+    if(status < 0){
+        sys_exit(-1);
+    }
+}
+
+//Prints how often each system call was made and the timer ticks spent in it
+void
+syscall_print_stats(void)
+{
+    int i;
+
+    for(i = 0; i < SYSCALL_CNT; i++){
+        if(syscall_stats[i].calls > 0){
+            printf("Syscall %s: %lld calls, %lld ticks\n",
+                   syscalls[i].name, syscall_stats[i].calls, syscall_stats[i].ticks);
+        }
     }
 }
 
@@ -148,39 +252,51 @@ void sys_seek(int fd, unsigned position){
         effort in system call implementation.
     */
 
-    file_seek(thread_current()->pcb.file_descriptor_table[fd], position);
+    struct file* seek_file = fd_table_get(&thread_current()->pcb.fds, fd);
+    if(seek_file == NULL){
+        return;
+    }
+    file_seek(seek_file, position);
 }
 
-void sys_halt (void){
+unsigned sys_tell(int fd){
     /*
-    System Call: void halt (void)
-        Terminates Pintos by calling shutdown_power_off() (declared in "devices/shutdown.h").
-        This should be seldom used, because you lose some information about possible deadlock situations, etc. 
+    System Call: unsigned tell (int fd)
+        Returns the position of the next byte to be read or written in open file fd, expressed in bytes from the
+        beginning of the file.
     */
+    struct file* tell_file = fd_table_get(&thread_current()->pcb.fds, fd);
+    unsigned position;
 
-    shutdown_power_off();
+    if(tell_file == NULL){
+        return -1;
+    }
+    position = file_tell(tell_file);
+    return position;
 }
 
-int has_children(struct thread* t){
-    if(list_size(&t->child_wait_for_my_exit.waiters) > 0){
-        return true;
+void sys_close(int fd){
+    /*
+    System Call: void close (int fd)
+        Closes file descriptor fd. Exiting or terminating a process implicitly closes all its open file descriptors,
+        as if by calling this function for each one.
+    */
+    struct file* close_file = fd_table_remove(&thread_current()->pcb.fds, fd);
+
+    if(close_file == NULL){
+        return;
     }
-    return false;
+    file_close(close_file);
 }
 
-int num_children(struct thread* t){
-    int numChildren = list_size(&t->child_wait_for_my_exit.waiters);
-    return numChildren;
-}
+void sys_halt (void){
+    /*
+    System Call: void halt (void)
+        Terminates Pintos by calling shutdown_power_off() (declared in "devices/shutdown.h").
+        This should be seldom used, because you lose some information about possible deadlock situations, etc. 
+    */
 
-bool has_parent(struct thread* t){
-    struct thread *par;
-    if(t->pcb.parent_tid != 1){
-        if(get_thread_tcb(t->pcb.parent_tid, &par) != -1){
-            return true;
-        }
-    }
-    return false;
+    shutdown_power_off();
 }
 
 void sys_exit(int status){
@@ -192,46 +308,14 @@ void sys_exit(int status){
     */
 
     struct thread *cur = thread_current();
-    struct thread *par;
 
     printf("%s: exit(%d)\n", cur->name, status);
     cur->exit_status = status;
-    cur->completed_executing = true;
-
-    //Cleanup of resources
-    //printf("---Pre Clean\n");
-    if(cur->file_executable) {
-        file_allow_write(cur->file_executable);
-        file_close(cur->file_executable);
-    }
-
-    //------Myself and Parent Sync------
-    if( has_parent(cur) ){
-        //Exiting has a child process. Possible for parent to call wait
-        get_thread_tcb(cur->pcb.parent_tid, &par);
-        sema_up(&cur->parent_wait_for_my_exit); //Exit status available to parent
-    } else {    
-        //Waiting for Kernel which is the parent in this case
-        sema_up(&cur->parent_wait_for_my_exit);
-        sema_down(&cur->myself_wait_for_parent_exit);
-    }
-
-    //------Myself and Child Sync------
-    if( has_children(cur) ){
-        for(int i = 0; i < num_children(cur); i++){
-            //Let all children exit
-            sema_up(&cur->child_wait_for_my_exit);
-            sema_down(&cur->myself_wait_for_child_exit);
-        }
-    }
-    
 
-    
-    if( has_parent(cur) ){
-        sema_down(&par->child_wait_for_my_exit);
-        sema_up(&par->myself_wait_for_child_exit);
-    }
+    //Close every file we still have open
+    fd_table_destroy(&cur->pcb.fds);
 
+    //process_exit() publishes the status and frees everything else
     thread_exit();
 }
 
@@ -246,13 +330,9 @@ int sys_exec (const char *cmd_line){
         synchronization to ensure this.
     */
    tid_t process_tid = -1;
-   if(cmd_line == NULL){
-       return -1;
-   }
+   //process_execute() only returns once the child knows whether it loaded
    process_tid = process_execute(cmd_line);
-   //Wait on the child process to down your semaphore. This means child is running :)
-   sema_down(&thread_current()->exec_wait_on_child_register);
-   if(thread_current()->pcb.child_exec_fail == 1){
+   if(process_tid == TID_ERROR){
        return -1;
    }
    return process_tid;
@@ -295,31 +375,12 @@ int sys_wait(tid_t tid){
 
     */
 
-    struct thread *cur = thread_current();
-    struct thread *child;
-
-    //Check if tid is a valid child
-    if(get_thread_tcb(tid, &child) == -1){
-        return -1;
-    }
-    //Make sure the child's parent is you
-    if(child->pcb.parent_tid != cur->tid){
-        return -1;
-    }
-    //Make sure someone has already called wait
-    if(child->already_waiting){
-        return -1;
-    }
-    child->already_waiting = true;
-    //Now we can wait on the child to complete if it hasn't already
-    if(!child->completed_executing){
-        sema_down(&child->parent_wait_for_my_exit);
-    }
-    return child->exit_status;
+    //process_wait() rejects tids that are not our children or were already waited for
+    return process_wait(tid);
 
 }
 
-int sys_write (int fd, char *buffer, unsigned size) {
+int sys_write (int fd, const void *buffer, unsigned size) {
     /*
     System Call: int write (int fd, const void *buffer, unsigned size)
         Writes size bytes from buffer to the open file fd. Returns the number of bytes actually
@@ -337,25 +398,15 @@ int sys_write (int fd, char *buffer, unsigned size) {
         both human readers and our grading scripts.
     */
 
-    struct file* write_file;
+    struct iovec iov;
+
     int bytes_write;
 
-    if(fd == 1){
-       putbuf(buffer, size);
-       return size;
-    } else if(fd > 0 && fd < MAX_NUMBER_OF_FILES_IN_PROCESS){
-        //Make sure fd is valid
-        write_file = thread_current()->pcb.file_descriptor_table[fd];
-        if(write_file == NULL){
-            return -1;
-        }
-        //Write to the fd
-        aquire_fs_lock();
-        bytes_write = file_write(write_file, buffer, size);
-        release_fs_lock();
-        //Return write size
-    } else {
-        return -1;
+    iov.iov_base = (void *) buffer;
+    iov.iov_len = size;
+    bytes_write = write_iov(fd, &iov, 1);
+    if(bytes_write == IO_BAD_BUFFER){
+        sys_exit(-1);
     }
     return bytes_write;
 
@@ -380,21 +431,17 @@ int sys_open(const char *file){
     struct file* file_opened;
     int file_descriptor_opened;
 
-    if(!valid_pointer((void *) file)){
-        sys_exit(-1);
-    }
-
     //Open the file
-    aquire_fs_lock();
     file_opened = filesys_open(file);
-    release_fs_lock();
     if(file_opened == NULL){
         return -1;
     }
-    //Place file into PCB
-    file_descriptor_opened = thread_current()->pcb.number_open_files + 2;
-    thread_current()->pcb.file_descriptor_table[file_descriptor_opened] = file_opened;
-    thread_current()->pcb.number_open_files++;
+    //Place file into PCB, reusing a closed descriptor if there is one
+    file_descriptor_opened = fd_table_add(&thread_current()->pcb.fds, file_opened);
+    if(file_descriptor_opened == -1){
+        file_close(file_opened);
+        return -1;
+    }
 
     //printf("sys_open returning fd %i\n", file_descriptor_opened);
     return(file_descriptor_opened);
@@ -408,12 +455,7 @@ bool sys_create(const char *file, unsigned initial_size){
         require a open system call. 
     */
     bool file_created = false;
-    if(!valid_pointer((void *) file)){
-        sys_exit(-1);
-    }
-    aquire_fs_lock();
     file_created = filesys_create(file, initial_size);
-    release_fs_lock();
     return(file_created);
 }
 
@@ -424,12 +466,7 @@ bool sys_remove(const char *file){
         whether it is open or closed, and removing an open file does not close it. See Removing an Open File, for details. 
     */
     bool file_removed = false;
-    if(!valid_pointer((void *) file)){
-        sys_exit(-1);
-    }
-    aquire_fs_lock();
     file_removed = filesys_remove(file);
-    release_fs_lock();
     return(file_removed);
 }
 
@@ -440,24 +477,16 @@ int sys_read(int fd, void *buffer, unsigned size){
         Reads size bytes from the file open as fd into buffer. Returns the number of bytes actually read (0 at end of file), or -1
         if the file could not be read (due to a condition other than end of file). Fd 0 reads from the keyboard using input_getc().
     */
-    struct file* read_file;
-    int bytes_read = 0;
-    //printf("sys_read %i\n", fd);
-    //Reading from a file from sys_open()
-    if(fd > 0 && fd < MAX_NUMBER_OF_FILES_IN_PROCESS){
-        read_file = thread_current()->pcb.file_descriptor_table[fd];
-        if(read_file == NULL){
-             return -1;
-        }
-        //("sys_read %i\n", bytes_read);
-        aquire_fs_lock();
-        bytes_read = file_read(read_file, buffer, size);
-        release_fs_lock();
-        //printf("sys_read %i\n", bytes_read);
-    } else {
-        return -1;
-    }
+    struct iovec iov;
 
+    int bytes_read;
+
+    iov.iov_base = buffer;
+    iov.iov_len = size;
+    bytes_read = read_iov(fd, &iov, 1);
+    if(bytes_read == IO_BAD_BUFFER){
+        sys_exit(-1);
+    }
     return bytes_read;
 }
 
@@ -470,66 +499,350 @@ int sys_filesize(int fd){
     uint32_t f_length = 0;
 
     struct file* read_file;
-    read_file = thread_current()->pcb.file_descriptor_table[fd];
+    read_file = fd_table_get(&thread_current()->pcb.fds, fd);
     if(read_file == NULL){
             return -1;
     }
-    aquire_fs_lock();
     f_length = file_length(read_file);
-    release_fs_lock();
     return(f_length);
 }
 
-void aquire_fs_lock(void){
-    lock_acquire(&file_lock);
+bool sys_chdir(const char *dir){
+    /*
+    System Call: bool chdir (const char *dir)
+        Changes the current working directory of the process to dir, which may be relative or absolute.
+        Returns true if successful, false on failure.
+    */
+    return filesys_chdir(dir);
 }
-void release_fs_lock(void){
-    lock_release(&file_lock);
+
+bool sys_mkdir(const char *dir){
+    /*
+    System Call: bool mkdir (const char *dir)
+        Creates the directory named dir, which may be relative or absolute. Returns true if successful,
+        false on failure. Fails if dir already exists or if any directory name in dir, besides the last,
+        does not already exist. That is, mkdir("/a/b/c") succeeds only if /a/b already exists and
+        /a/b/c does not.
+    */
+    return filesys_mkdir(dir);
 }
 
-int valid_pointer(void* provided_pointer){
-    if(provided_pointer == NULL){
-        return 0;
+bool sys_readdir(int fd, char *name){
+    /*
+    System Call: bool readdir (int fd, char *name)
+        Reads a directory entry from file descriptor fd, which must represent a directory. If successful,
+        stores the null-terminated file name in name, which must have room for READDIR_MAX_LEN + 1 bytes,
+        and returns true. If no entries are left in the directory, returns false.
+
+        "." and ".." should not be returned by readdir.
+    */
+    struct file* dir_file = fd_table_get(&thread_current()->pcb.fds, fd);
+    struct dir* dir;
+    char kname[NAME_MAX + 1];
+    bool success;
+
+    if(dir_file == NULL || !inode_is_dir(file_get_inode(dir_file))){
+        return false;
     }
-    //if(provided_pointer > PHYS_BASE || provided_pointer < 0x08084000){
-    if(provided_pointer > PHYS_BASE){
-        return 0;
+    //The fd's file position doubles as the directory position
+    dir = dir_open(inode_reopen(file_get_inode(dir_file)));
+    if(dir == NULL){
+        return false;
     }
-    if(get_user((uint8_t*) provided_pointer) == -1){
-        return 0;
+    dir_seek(dir, file_tell(dir_file));
+    success = dir_readdir(dir, kname);
+    file_seek(dir_file, dir_tell(dir));
+    dir_close(dir);
+    if(success && !copy_to_user(name, kname, strlen(kname) + 1)){
+        sys_exit(-1);
     }
-    return 1;
+    return success;
 }
 
-int valid_arg(void* arg_address){
-    if(arg_address >= (void*) 0xC0000000){
-        return 0;
+bool sys_isdir(int fd){
+    /*
+    System Call: bool isdir (int fd)
+        Returns true if fd represents a directory, false if it represents an ordinary file.
+    */
+    struct file* isdir_file = fd_table_get(&thread_current()->pcb.fds, fd);
+
+    if(isdir_file == NULL){
+        return false;
     }
-    return 1;
+    return inode_is_dir(file_get_inode(isdir_file));
 }
 
-/* Reads a byte at user virtual address UADDR.
-   UADDR must be below PHYS_BASE.
-   Returns the byte value if successful, -1 if a segfault
-   occurred. */
-static int get_user (const uint8_t *uaddr)
-{
-  int result;
-  asm ("movl $1f, %0; movzbl %1, %0; 1:"
-       : "=&a" (result) : "m" (*uaddr));
-  return result;
+int sys_inumber(int fd){
+    /*
+    System Call: int inumber (int fd)
+        Returns the inode number of the inode associated with fd, which may represent an ordinary file
+        or a directory.
+    */
+    struct file* inumber_file = fd_table_get(&thread_current()->pcb.fds, fd);
+
+    if(inumber_file == NULL){
+        return -1;
+    }
+    return inode_get_inumber(file_get_inode(inumber_file));
 }
 
+int sys_readv(int fd, const struct iovec *iov, int iovcnt){
+    /*
+    System Call: int readv (int fd, const struct iovec *iov, int iovcnt)
+        Reads from the file open as fd into the iovcnt buffers described by iov, filling each in turn before
+        the next. Returns the total number of bytes read, which is less than the total size of the buffers only
+        at end of file, or -1 if fd is not an open file or iovcnt is negative or more than IOV_MAX.
+    */
+    return vector_io(fd, iov, iovcnt, read_iov);
+}
 
-/* Writes BYTE to user address UDST.
-   UDST must be below PHYS_BASE.
-   Returns true if successful, false if a segfault occurred. */
-   /*
-static bool put_user (uint8_t *udst, uint8_t byte)
-{
-  int error_code;
-  asm ("movl $1f, %0; movb %b2, %1; 1:"
-       : "=&a" (error_code), "=m" (*udst) : "q" (byte));
-  return error_code != -1;
+int sys_writev(int fd, const struct iovec *iov, int iovcnt){
+    /*
+    System Call: int writev (int fd, const struct iovec *iov, int iovcnt)
+        Writes the iovcnt buffers described by iov, in order, to the open file fd, as if they were one buffer
+        passed to write. Returns the total number of bytes written, or -1 if fd cannot be written or iovcnt is
+        negative or more than IOV_MAX.
+    */
+    //Small buffers are gathered into one page, so a record made of many pieces costs one trap and one
+    //inode_write_at(), and reaches the console in one putbuf()
+    return vector_io(fd, iov, iovcnt, write_iov);
+}
+
+//Copies in the IOVCNT entries at user address UIOV and runs TRANSFER on them, killing the process if any buffer is bad
+static int vector_io(int fd, const struct iovec *uiov, int iovcnt,
+                     int (*transfer)(int fd, const struct iovec *iov, int iovcnt)){
+    struct iovec *iov;
+    int result;
+
+    if(iovcnt < 0 || iovcnt > IOV_MAX){
+        return -1;
+    }
+    iov = iovcnt > 0 ? malloc(iovcnt * sizeof *iov) : NULL;
+    if(iovcnt > 0 && iov == NULL){
+        return -1;
+    }
+    if(!copy_from_user(iov, uiov, iovcnt * sizeof *iov)){
+        free(iov);
+        sys_exit(-1);
+    }
+    result = transfer(fd, iov, iovcnt);
+    free(iov);
+    if(result == IO_BAD_BUFFER){
+        sys_exit(-1);
+    }
+    return result;
+}
+
+//Writes the user buffers described by IOV, which is in kernel memory, to FD, a page at a time
+//Returns the number of bytes written, -1 if FD cannot be written, or IO_BAD_BUFFER
+static int write_iov(int fd, const struct iovec *iov, int iovcnt){
+    struct file* write_file = NULL;
+    char *kbuf;
+    unsigned bytes_write = 0;
+    unsigned fill = 0;
+    bool more = true;
+    int i;
+
+    if(fd != 1){
+        //Make sure fd is valid, directories are only written through mkdir/remove
+        write_file = fd_table_get(&thread_current()->pcb.fds, fd);
+        if(write_file == NULL || inode_is_dir(file_get_inode(write_file))){
+            return -1;
+        }
+    }
+
+    kbuf = palloc_get_page(0);
+    if(kbuf == NULL){
+        return -1;
+    }
+    for(i = 0; i <= iovcnt && more; i++){
+        const char *base = i < iovcnt ? iov[i].iov_base : NULL;
+        size_t left = i < iovcnt ? iov[i].iov_len : 0;
+
+        //Gather into KBUF, then write it out whenever it is full and once more at the end
+        while(left > 0 || (i == iovcnt && fill > 0)){
+            unsigned chunk = left < PGSIZE - fill ? left : PGSIZE - fill;
+            unsigned written;
+
+            if(!copy_from_user(kbuf + fill, base, chunk)){
+                palloc_free_page(kbuf);
+                return IO_BAD_BUFFER;
+            }
+            fill += chunk;
+            base += chunk;
+            left -= chunk;
+            if(fill < PGSIZE && i < iovcnt){
+                continue;
+            }
+
+            if(fd == 1){
+                putbuf(kbuf, fill);
+                written = fill;
+            } else {
+                written = file_write(write_file, kbuf, fill);
+            }
+            bytes_write += written;
+            //Stop at end of file
+            if(written < fill){
+                more = false;
+                break;
+            }
+            fill = 0;
+        }
+    }
+    palloc_free_page(kbuf);
+    return bytes_write;
+}
+
+//Reads from FD into the user buffers described by IOV, which is in kernel memory, a page at a time
+//Returns the number of bytes read, -1 if FD cannot be read, or IO_BAD_BUFFER
+static int read_iov(int fd, const struct iovec *iov, int iovcnt){
+    struct file* read_file;
+    char *kbuf;
+    unsigned bytes_read = 0;
+    int i = 0;
+    size_t ofs = 0; //Bytes of iov[i] already filled
+
+    //Reading from a file from sys_open()
+    read_file = fd_table_get(&thread_current()->pcb.fds, fd);
+    if(read_file == NULL || inode_is_dir(file_get_inode(read_file))){
+         return -1;
+    }
+
+    kbuf = palloc_get_page(0);
+    if(kbuf == NULL){
+        return -1;
+    }
+    for(;;){
+        unsigned want = 0;
+        unsigned got, done;
+        size_t o = ofs;
+        int j;
+
+        //Read as much as fits in KBUF and is still wanted, in one go
+        for(j = i; j < iovcnt && want < PGSIZE; j++, o = 0){
+            size_t room = iov[j].iov_len - o;
+            want += room < PGSIZE - want ? room : PGSIZE - want;
+        }
+        if(want == 0){
+            break;
+        }
+        got = file_read(read_file, kbuf, want);
+
+        //Scatter it over the buffers
+        for(done = 0; done < got; ){
+            size_t n = iov[i].iov_len - ofs < got - done ? iov[i].iov_len - ofs : got - done;
+
+            if(!copy_to_user((char *) iov[i].iov_base + ofs, kbuf + done, n)){
+                palloc_free_page(kbuf);
+                return IO_BAD_BUFFER;
+            }
+            done += n;
+            ofs += n;
+            if(ofs == iov[i].iov_len){
+                i++;
+                ofs = 0;
+            }
+        }
+        bytes_read += got;
+        //Stop at end of file
+        if(got < want){
+            break;
+        }
+    }
+    palloc_free_page(kbuf);
+    return bytes_read;
+}
+
+#ifdef VM
+int sys_mmap(int fd, void *addr){
+    /*
+    System Call: mapid_t mmap (int fd, void *addr)
+        Maps the file open as fd into the process's virtual address space. The entire file is mapped into
+        consecutive virtual pages starting at addr. Fails if the file has a length of zero, if addr is not
+        page-aligned, if the range overlaps any existing set of mapped pages, or if addr is 0. File descriptors
+        0 and 1, representing console input and output, are not mappable.
+    */
+    struct file* mmap_file = fd_table_get(&thread_current()->pcb.fds, fd);
+
+    if(mmap_file == NULL || inode_is_dir(file_get_inode(mmap_file))){
+        return MAP_FAILED;
+    }
+    //Pages are loaded on demand and share frames with other mappings of the file (see vm/mmap.c)
+    return mmap_map(mmap_file, addr);
+}
+
+void sys_munmap(int mapping){
+    /*
+    System Call: void munmap (mapid_t mapping)
+        Unmaps the mapping designated by mapping, which must be a mapping ID returned by a previous call to mmap
+        by the same process that has not yet been unmapped. Pages written by the process are written back to the file.
+    */
+    mmap_unmap(mapping);
+}
+
+int sys_fork(struct intr_frame *f){
+    /*
+    System Call: pid_t fork (void)
+        Creates a new process that is a copy of the calling process: the same memory contents, the same open
+        files at the same positions, the same mappings and working directory. Both processes return from fork,
+        the parent with the child's pid and the child with 0. Returns -1 if the copy cannot be made. The child
+        can be waited for like one started by exec.
+    */
+    //Memory is shared copy-on-write until either process writes to it (see vm/frame.c)
+    return process_fork(f);
+}
+#endif
+
+//Copies CNT words of arguments from user address UARGS into ARGS, or kills the process if they are not readable
+static void get_args(const int *uargs, int *args, size_t cnt){
+    if(!copy_from_user(args, uargs, cnt * sizeof *args)){
+        sys_exit(-1);
+    }
+}
+
+//Checks ARGS against DESC, replacing each string argument by a kernel copy also stored in STRINGS
+//Returns 1 if the call can go ahead, 0 if it should fail with DESC's error, -1 if the process must die
+static int check_args(const struct syscall_desc *desc, int *args, char **strings){
+    int i;
+
+    for(i = 0; i < desc->arg_cnt; i++){
+        switch(desc->args[i]){
+            case ARG_STRING:
+                if(!copy_in_string((const char*) args[i], &strings[i])){
+                    return -1;
+                }
+                if(strings[i] == NULL){
+                    return 0;
+                }
+                args[i] = (int) strings[i];
+                break;
+            case ARG_BUFFER:
+                if(!is_user_range((const void*) args[i], (unsigned) args[i + 1])){
+                    return -1;
+                }
+                break;
+            case ARG_INT:
+            case ARG_UADDR:
+                break;
+        }
+    }
+    return 1;
+}
+
+//Copies the user string USTR into a new page stored in *KSTR, which the caller must free with palloc_free_page()
+//Returns false if USTR is not readable. Otherwise *KSTR is NULL if the string does not fit in a page or memory is short
+static bool copy_in_string(const char *ustr, char **kstr){
+    int length;
+
+    *kstr = palloc_get_page(0);
+    if(*kstr == NULL){
+        return true;
+    }
+    length = strncpy_from_user(*kstr, ustr, PGSIZE);
+    if(length < 0 || length == PGSIZE){
+        palloc_free_page(*kstr);
+        *kstr = NULL;
+    }
+    return length >= 0;
 }
-*/
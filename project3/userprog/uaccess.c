@@ -0,0 +1,139 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+
+#include "threads/vaddr.h"
+
+/* The kernel runs with the user's page directory active, so it
+ * can reach user memory directly, but a bad user pointer must
+ * not bring it down.  Each page of a user range is probed once
+ * with get_user() or put_user(), whose faults page_fault() turns
+ * into a failed return instead of a kernel oops, and only then is
+ * the range copied, a word at a time.  With VM the probe also
+ * brings the page in.  Should it be evicted again before the copy,
+ * the copy faults it back in, and if that fails the copy stops
+ * and reports failure the same way get_user() does. */
+
+static bool copy_words(void *dst, const void *src, size_t size);
+static int get_user(const uint8_t *uaddr);
+static bool put_user(uint8_t *udst, uint8_t byte);
+
+/* Copies SIZE bytes from user address USRC to kernel address
+ * DST.  Returns false if any of the source is not readable user
+ * memory or cannot be brought in. */
+bool
+copy_from_user(void *dst, const void *usrc, size_t size)
+{
+    const uint8_t *end = (const uint8_t *) usrc + size;
+    const uint8_t *p;
+
+    if (!is_user_range(usrc, size)) {
+        return false;
+    }
+    for (p = usrc; p < end; p = (const uint8_t *) pg_round_down(p) + PGSIZE) {
+        if (get_user(p) == -1) {
+            return false;
+        }
+    }
+    return copy_words(dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+ * UDST.  Returns false, having copied nothing, if any of the
+ * destination is not writable user memory, or having copied part
+ * of it if it cannot be brought in. */
+bool
+copy_to_user(void *udst, const void *src, size_t size)
+{
+    uint8_t *end = (uint8_t *) udst + size;
+    uint8_t *p;
+
+    if (!is_user_range(udst, size)) {
+        return false;
+    }
+    for (p = udst; p < end; p = (uint8_t *) pg_round_down(p) + PGSIZE) {
+        int byte = get_user(p);
+        if (byte == -1 || !put_user(p, byte)) {
+            return false;
+        }
+    }
+    return copy_words(udst, src, size);
+}
+
+/* Copies the null-terminated string at user address USRC,
+ * terminator included, into the SIZE bytes at DST.  Returns the
+ * length of the string, or SIZE if it does not fit, in which case
+ * DST is not terminated.  Returns -1 if the string runs into
+ * memory that is not readable user memory. */
+int
+strncpy_from_user(char *dst, const char *usrc, size_t size)
+{
+    size_t len;
+
+    for (len = 0; len < size; len++) {
+        int c;
+
+        if (!is_user_vaddr(usrc + len)
+            || (c = get_user((const uint8_t *) usrc + len)) == -1) {
+            return -1;
+        }
+        if ((dst[len] = c) == '\0') {
+            return len;
+        }
+    }
+    return len;
+}
+
+/* Returns true if the SIZE bytes at UADDR lie below PHYS_BASE.
+ * They need not be mapped. */
+bool
+is_user_range(const void *uaddr, size_t size)
+{
+    uintptr_t addr = (uintptr_t) uaddr;
+
+    return addr <= (uintptr_t) PHYS_BASE
+           && size <= (uintptr_t) PHYS_BASE - addr;
+}
+
+/* Copies SIZE bytes from SRC to DST, which must not overlap, four
+ * at a time and then the odd bytes one at a time.  Returns false
+ * if a fault on user memory could not be resolved, in which case
+ * only part of SRC was copied. */
+static bool
+copy_words(void *dst, const void *src, size_t size)
+{
+    size_t words = size / sizeof(uint32_t);
+    size_t bytes = size % sizeof(uint32_t);
+    int result;
+
+    asm volatile ("movl $1f, %0; cld; rep movsl; movl %4, %%ecx; "
+                  "rep movsb; 1:"
+                  : "=&a" (result), "+D" (dst), "+S" (src), "+c" (words)
+                  : "r" (bytes)
+                  : "memory", "cc");
+    return result != -1;
+}
+
+/* Reads a byte at user virtual address UADDR.
+ * UADDR must be below PHYS_BASE.
+ * Returns the byte value if successful, -1 if a segfault
+ * occurred. */
+static int
+get_user(const uint8_t *uaddr)
+{
+    int result;
+    asm ("movl $1f, %0; movzbl %1, %0; 1:"
+         : "=&a" (result) : "m" (*uaddr));
+    return result;
+}
+
+/* Writes BYTE to user address UDST.
+ * UDST must be below PHYS_BASE.
+ * Returns true if successful, false if a segfault occurred. */
+static bool
+put_user(uint8_t *udst, uint8_t byte)
+{
+    int error_code;
+    asm ("movl $1f, %0; movb %b2, %1; 1:"
+         : "=&a" (error_code), "=m" (*udst) : "q" (byte));
+    return error_code != -1;
+}
@@ -0,0 +1,704 @@
+#include <debug.h>
+#include <string.h>
+
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* The page-out daemon tries to keep at least PAGEOUT_LOW_WATER
+ * pages of the user pool free.  Pages are written out in
+ * clusters of up to PAGEOUT_BATCH, by the daemon and by a process
+ * that finds the pool empty anyway. */
+#define PAGEOUT_LOW_WATER 8
+#define PAGEOUT_BATCH 8
+
+/* Every frame that holds a user page, in the order the clock
+ * hand visits them, and the shared frames indexed by file region.
+ * The list, the index, the clock hand and the fields of each
+ * frame, as well as the `frame' and `swap_slot' members of every
+ * resident page, are protected by frame_lock.
+ *
+ * A frame is pinned and busy while its contents are being read
+ * in or written out, and the pages that map it are not mapped
+ * during that time.  A process that needs a busy frame waits on
+ * frame_idle until the I/O completes.
+ *
+ * A fork shares each of the parent's private frames with the
+ * child by mapping it read-only in both.  The pages sharing a
+ * frame also share a swap slot, if they have one, since their
+ * contents are the same.
+ *
+ * Pages that are still all zeros are mapped read-only to a single
+ * zero frame, which is not in the frame table and is never
+ * evicted or freed, until they are written. */
+static struct list frames;
+static struct hash shared_frames;
+static struct list_elem *clock_hand;
+static struct lock frame_lock;
+static struct condition frame_idle;     /* A frame stopped being busy. */
+static struct condition pageout_wanted; /* The pool is running low. */
+static struct frame zero_frame;
+
+static struct frame *frame_get(void);
+static size_t page_out(struct frame *victims[], size_t max);
+static bool frame_unmap(struct frame *);
+static void frame_remap(struct frame *);
+static void frame_set_slot(struct frame *, size_t slot);
+static struct frame *clock_victim(void);
+static struct frame *clock_next(void);
+static void frame_destroy(struct frame *);
+static struct frame *shared_find(struct inode *, off_t, size_t);
+static hash_hash_func shared_hash;
+static hash_less_func shared_less;
+static void pageout_daemon(void *aux);
+
+/* Initializes the frame table and starts the page-out daemon. */
+void
+frame_init(void)
+{
+    list_init(&frames);
+    if (!hash_init(&shared_frames, shared_hash, shared_less, NULL)) {
+        PANIC("can't create shared frame index");
+    }
+    clock_hand = list_end(&frames);
+    lock_init(&frame_lock);
+    cond_init(&frame_idle);
+    cond_init(&pageout_wanted);
+
+    zero_frame.kpage = palloc_get_page(PAL_ZERO);
+    if (zero_frame.kpage == NULL) {
+        PANIC("can't allocate zero frame");
+    }
+    list_init(&zero_frame.pages);
+    zero_frame.pin_cnt = 1;
+    zero_frame.busy = zero_frame.dirty = false;
+    zero_frame.inode = NULL;
+
+    thread_create("page-out", PRI_DEFAULT, pageout_daemon, NULL);
+}
+
+/* Obtains a frame for page P of the running process, which is
+ * not mapped, and records it as P's frame in *FP, waiting first
+ * for any eviction of P in progress.  If P is shared and another
+ * page already has its file region in a frame, uses that frame
+ * and sets *FRESH to false.  Otherwise uses a new frame, evicting
+ * other pages if the user pool is exhausted, and sets *FRESH to
+ * true: the caller must fill it.  Either way the frame is pinned,
+ * and the caller must map P and then call frame_unpin().
+ *
+ * If the eviction found nowhere to write P and mapped it again,
+ * sets *FP to a null pointer instead: the access can simply be
+ * retried.  Returns false if no frame can be freed. */
+bool
+frame_alloc(struct page *p, struct frame **fp, bool *fresh)
+{
+    struct inode *inode = p->shared ? file_get_inode(p->file) : NULL;
+    struct frame *f;
+
+    lock_acquire(&frame_lock);
+    while (p->frame != NULL && p->frame->busy) {
+        cond_wait(&frame_idle, &frame_lock);
+    }
+    if (p->frame != NULL) {
+        lock_release(&frame_lock);
+        *fp = NULL;
+        return true;
+    }
+
+    for (;;) {
+        f = inode != NULL ? shared_find(inode, p->ofs, p->read_bytes) : NULL;
+        if (f != NULL) {
+            if (f->busy) {
+                cond_wait(&frame_idle, &frame_lock);
+                continue;
+            }
+            f->pin_cnt++;
+            *fresh = false;
+            break;
+        }
+
+        f = frame_get();
+        if (f == NULL) {
+            break;
+        }
+        if (inode != NULL) {
+            if (shared_find(inode, p->ofs, p->read_bytes) != NULL) {
+                /* Another process brought the region in while we
+                 * were paging out. */
+                frame_destroy(f);
+                continue;
+            }
+            f->inode = inode;
+            f->ofs = p->ofs;
+            f->read_bytes = p->read_bytes;
+            hash_insert(&shared_frames, &f->share_elem);
+        }
+        *fresh = true;
+        break;
+    }
+
+    if (f != NULL) {
+        list_push_back(&f->pages, &p->frame_elem);
+        p->frame = f;
+    }
+    lock_release(&frame_lock);
+    *fp = f;
+    return f != NULL;
+}
+
+/* Maps page P of the running process, which has never been
+ * written and is all zeros, read-only to the zero frame, once any
+ * eviction of P in progress is over.  Returns true without doing
+ * anything if the eviction mapped P again.  Returns false if P
+ * turns out to have been written to swap meanwhile, or memory is
+ * exhausted; the caller must then give P a frame of its own. */
+bool
+frame_map_zero(struct page *p)
+{
+    bool success = false;
+
+    ASSERT(p->read_bytes == 0);
+
+    lock_acquire(&frame_lock);
+    while (p->frame != NULL && p->frame->busy) {
+        cond_wait(&frame_idle, &frame_lock);
+    }
+    if (p->frame != NULL) {
+        success = true;
+    } else if (p->swap_slot == SWAP_NONE
+        && pagedir_set_page(p->owner->pagedir, p->upage, zero_frame.kpage,
+                            false)) {
+        list_push_back(&zero_frame.pages, &p->frame_elem);
+        p->frame = &zero_frame;
+        success = true;
+    }
+    lock_release(&frame_lock);
+    return success;
+}
+
+/* Drops a pin on F, marking it no longer busy. */
+void
+frame_unpin(struct frame *f)
+{
+    lock_acquire(&frame_lock);
+    ASSERT(f->pin_cnt > 0);
+    f->pin_cnt--;
+    if (f->busy) {
+        f->busy = false;
+        cond_broadcast(&frame_idle, &frame_lock);
+    }
+    lock_release(&frame_lock);
+}
+
+/* Unmaps page P of the running process from its frame, if it
+ * has one, waiting for any I/O in progress to finish.  Frees the
+ * frame once no page maps it, first writing a dirty shared frame
+ * back to its file. */
+void
+frame_free(struct page *p)
+{
+    uint32_t *pd = p->owner->pagedir;
+    struct frame *f;
+
+    lock_acquire(&frame_lock);
+    while (p->frame != NULL && p->frame->busy) {
+        cond_wait(&frame_idle, &frame_lock);
+    }
+    f = p->frame;
+    if (f != NULL) {
+        pagedir_clear_page(pd, p->upage);
+        if (pagedir_is_dirty(pd, p->upage)) {
+            f->dirty = true;
+        }
+        list_remove(&p->frame_elem);
+        p->frame = NULL;
+
+        if (list_empty(&f->pages) && f != &zero_frame) {
+            if (f->inode != NULL) {
+                if (f->dirty) {
+                    f->pin_cnt++;
+                    f->busy = true;
+                    lock_release(&frame_lock);
+                    inode_write_at(f->inode, f->kpage, f->read_bytes, f->ofs);
+                    lock_acquire(&frame_lock);
+                    cond_broadcast(&frame_idle, &frame_lock);
+                }
+                hash_delete(&shared_frames, &f->share_elem);
+            }
+            frame_destroy(f);
+        }
+    }
+    lock_release(&frame_lock);
+}
+
+/* Lets page P, the running process's copy of page PARENT of the
+ * process it was forked from, share what PARENT has: its swap
+ * slot, and its frame if it is in one.  A private frame is mapped
+ * read-only by both pages from then on, so that whichever writes
+ * first gets a copy from frame_unshare().  Returns false if
+ * memory is exhausted. */
+bool
+frame_fork(struct page *parent, struct page *p)
+{
+    struct frame *f;
+    bool success = true;
+
+    lock_acquire(&frame_lock);
+    while (parent->frame != NULL && parent->frame->busy) {
+        cond_wait(&frame_idle, &frame_lock);
+    }
+    if (parent->swap_slot != SWAP_NONE) {
+        swap_ref(parent->swap_slot);
+        p->swap_slot = parent->swap_slot;
+    }
+    f = parent->frame;
+    if (f != NULL) {
+        if (f->inode == NULL) {
+            pagedir_set_writable(parent->owner->pagedir, parent->upage,
+                                 false);
+        }
+        if (pagedir_set_page(p->owner->pagedir, p->upage, f->kpage,
+                             f->inode != NULL && p->writable)) {
+            list_push_back(&f->pages, &p->frame_elem);
+            p->frame = f;
+        } else {
+            success = false;
+        }
+    }
+    lock_release(&frame_lock);
+    return success;
+}
+
+/* Lets the running process write to its page P, which is mapped
+ * read-only because its private frame was shared by a fork or is
+ * the zero frame.  If other pages still map the frame, or it is
+ * the zero frame, moves P to a copy of its own; otherwise just
+ * maps the frame writable.  Returns true if the
+ * faulting access can be retried, false if no frame can be
+ * freed for the copy. */
+bool
+frame_unshare(struct page *p)
+{
+    uint32_t *pd = p->owner->pagedir;
+    struct frame *f, *copy;
+
+    lock_acquire(&frame_lock);
+    while (p->frame != NULL && p->frame->busy) {
+        cond_wait(&frame_idle, &frame_lock);
+    }
+    f = p->frame;
+    if (f == NULL) {
+        /* Paged out meanwhile.  The retry faults it back in. */
+        lock_release(&frame_lock);
+        return true;
+    }
+    ASSERT(f->inode == NULL);
+
+    if (f != &zero_frame && list_size(&f->pages) == 1) {
+        pagedir_set_writable(pd, p->upage, true);
+        lock_release(&frame_lock);
+        return true;
+    }
+
+    f->pin_cnt++;
+    copy = frame_get();
+    f->pin_cnt--;
+    if (copy == NULL) {
+        lock_release(&frame_lock);
+        return false;
+    }
+    memcpy(copy->kpage, f->kpage, PGSIZE);
+    pagedir_clear_page(pd, p->upage);
+    if (pagedir_is_dirty(pd, p->upage)) {
+        f->dirty = true;
+    }
+    list_remove(&p->frame_elem);
+    copy->dirty = f->dirty;
+    list_push_back(&copy->pages, &p->frame_elem);
+    p->frame = copy;
+    pagedir_set_page(pd, p->upage, copy->kpage, true);
+    copy->pin_cnt--;
+    copy->busy = false;
+    cond_broadcast(&frame_idle, &frame_lock);
+
+    /* The other pages may have let go while frame_get() paged
+     * out. */
+    if (list_empty(&f->pages) && f != &zero_frame) {
+        frame_destroy(f);
+    }
+    lock_release(&frame_lock);
+    return true;
+}
+
+/* Returns a frame mapped by no page, pinned once and busy, taken
+ * from the user pool or freed by paging out, or a null pointer if
+ * there is none to be had.  Must be called with frame_lock held;
+ * releases it while paging out. */
+static struct frame *
+frame_get(void)
+{
+    struct frame *victims[PAGEOUT_BATCH];
+    struct frame *f = NULL;
+    void *kpage;
+    size_t cnt, i;
+
+    kpage = palloc_get_page(PAL_USER);
+    if (kpage != NULL) {
+        f = malloc(sizeof *f);
+        if (f == NULL) {
+            palloc_free_page(kpage);
+        } else {
+            f->kpage = kpage;
+            list_init(&f->pages);
+            f->inode = NULL;
+            list_push_back(&frames, &f->elem);
+        }
+    } else {
+        /* The daemon has fallen behind.  Page out a cluster
+         * ourselves, keep one frame and free the rest. */
+        cnt = page_out(victims, PAGEOUT_BATCH);
+        if (cnt > 0) {
+            f = victims[0];
+            for (i = 1; i < cnt; i++) {
+                frame_destroy(victims[i]);
+            }
+        }
+    }
+    if (palloc_free_cnt(PAL_USER) < PAGEOUT_LOW_WATER) {
+        cond_signal(&pageout_wanted, &frame_lock);
+    }
+
+    if (f != NULL) {
+        f->pin_cnt = 1;
+        f->busy = true;
+        f->dirty = false;
+    }
+    return f;
+}
+
+/* Evicts up to MAX frames chosen by the second-chance clock and
+ * stores them, pinned once and no longer mapped by any page, in
+ * VICTIMS.  Returns the number of frames stored, which is 0 if
+ * every frame is pinned or swap is full.
+ *
+ * Clean frames are dropped: their pages are read back from their
+ * file, their swap slot, or zeros.  Dirty shared frames are
+ * written back to their file.  A dirty private frame mapped by
+ * a single page that owns a slot is rewritten in place; the rest
+ * drop their slots and are given one run of contiguous slots, if
+ * swap has one, and written to it in a single pass.  All the
+ * pages of a frame share its new slot.
+ *
+ * Must be called with frame_lock held.  Releases it while
+ * writing. */
+static size_t
+page_out(struct frame *victims[], size_t max)
+{
+    bool own_slot[PAGEOUT_BATCH];  /* Rewrite the pages' slot in place. */
+    bool need_slot[PAGEOUT_BATCH]; /* Give the pages a new slot. */
+    void *run[PAGEOUT_BATCH];
+    size_t cnt = 0, run_cnt = 0, kept, i;
+    size_t run_slot = SWAP_NONE;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(max <= PAGEOUT_BATCH);
+
+    /* Unmap the victims first, so that nobody can dirty them
+     * after we look. */
+    while (cnt < max) {
+        struct frame *f = clock_victim();
+        struct page *p;
+        bool dirty;
+
+        if (f == NULL) {
+            break;
+        }
+        f->pin_cnt++;
+        f->busy = true;
+        dirty = frame_unmap(f);
+        own_slot[cnt] = need_slot[cnt] = false;
+        if (f->inode != NULL) {
+            f->dirty = dirty;
+        } else if (dirty) {
+            p = list_entry(list_front(&f->pages), struct page, frame_elem);
+            if (list_size(&f->pages) == 1 && p->swap_slot != SWAP_NONE
+                && !swap_shared(p->swap_slot)) {
+                own_slot[cnt] = true;
+            } else {
+                frame_set_slot(f, SWAP_NONE);
+                need_slot[cnt] = true;
+                run_cnt++;
+            }
+        }
+        victims[cnt++] = f;
+    }
+
+    /* Find slots for dirty private pages without one, preferably
+     * one contiguous run.  Put back any page we have nowhere to
+     * write. */
+    if (run_cnt > 0) {
+        run_slot = swap_alloc(run_cnt);
+    }
+    run_cnt = kept = 0;
+    for (i = 0; i < cnt; i++) {
+        struct frame *f = victims[i];
+
+        if (need_slot[i]) {
+            size_t slot;
+
+            if (run_slot != SWAP_NONE) {
+                slot = run_slot + run_cnt;
+                run[run_cnt++] = f->kpage;
+            } else {
+                slot = swap_alloc(1);
+                if (slot == SWAP_NONE) {
+                    frame_remap(f);
+                    f->pin_cnt--;
+                    f->busy = false;
+                    cond_broadcast(&frame_idle, &frame_lock);
+                    continue;
+                }
+                own_slot[i] = true;
+            }
+            frame_set_slot(f, slot);
+        }
+        own_slot[kept] = own_slot[i];
+        victims[kept++] = f;
+    }
+    cnt = kept;
+    if (cnt == 0) {
+        return 0;
+    }
+
+    /* Write. */
+    lock_release(&frame_lock);
+    if (run_cnt > 0) {
+        swap_write(run_slot, run, run_cnt);
+    }
+    for (i = 0; i < cnt; i++) {
+        struct frame *f = victims[i];
+
+        if (own_slot[i]) {
+            struct page *p = list_entry(list_front(&f->pages),
+                                        struct page, frame_elem);
+            swap_write(p->swap_slot, &f->kpage, 1);
+        } else if (f->inode != NULL && f->dirty) {
+            inode_write_at(f->inode, f->kpage, f->read_bytes, f->ofs);
+        }
+    }
+    lock_acquire(&frame_lock);
+
+    /* Detach the victims from their pages. */
+    for (i = 0; i < cnt; i++) {
+        struct frame *f = victims[i];
+
+        while (!list_empty(&f->pages)) {
+            struct list_elem *e = list_pop_front(&f->pages);
+            list_entry(e, struct page, frame_elem)->frame = NULL;
+        }
+        if (f->inode != NULL) {
+            hash_delete(&shared_frames, &f->share_elem);
+            f->inode = NULL;
+        }
+        f->busy = false;
+    }
+    cond_broadcast(&frame_idle, &frame_lock);
+    return cnt;
+}
+
+/* Unmaps every page that maps F.  Returns true if any of them
+ * had written to it, or F was already known to be dirty. */
+static bool
+frame_unmap(struct frame *f)
+{
+    bool dirty = f->dirty;
+    struct list_elem *e;
+
+    for (e = list_begin(&f->pages); e != list_end(&f->pages);
+         e = list_next(e)) {
+        struct page *p = list_entry(e, struct page, frame_elem);
+        uint32_t *pd = p->owner->pagedir;
+
+        pagedir_clear_page(pd, p->upage);
+        if (pagedir_is_dirty(pd, p->upage)) {
+            dirty = true;
+        }
+    }
+    return dirty;
+}
+
+/* Maps private frame F again for every page that maps it, after
+ * page_out() found nowhere to write it, and marks it dirty.  The
+ * pages stay read-only if there are several, as after a fork. */
+static void
+frame_remap(struct frame *f)
+{
+    bool writable = list_size(&f->pages) == 1;
+    struct list_elem *e;
+
+    for (e = list_begin(&f->pages); e != list_end(&f->pages);
+         e = list_next(e)) {
+        struct page *p = list_entry(e, struct page, frame_elem);
+
+        pagedir_set_page(p->owner->pagedir, p->upage, f->kpage,
+                         writable && p->writable);
+    }
+    f->dirty = true;
+}
+
+/* Gives every page that maps private frame F swap slot SLOT, or
+ * no slot if SLOT is SWAP_NONE, dropping the slot each had.  Each
+ * page holds its own reference to SLOT; a slot from swap_alloc()
+ * comes with the first. */
+static void
+frame_set_slot(struct frame *f, size_t slot)
+{
+    struct list_elem *e;
+
+    for (e = list_begin(&f->pages); e != list_end(&f->pages);
+         e = list_next(e)) {
+        struct page *p = list_entry(e, struct page, frame_elem);
+
+        if (p->swap_slot != SWAP_NONE) {
+            swap_free(p->swap_slot);
+        }
+        if (slot != SWAP_NONE && e != list_begin(&f->pages)) {
+            swap_ref(slot);
+        }
+        p->swap_slot = slot;
+    }
+}
+
+/* Runs the second-chance clock until it finds a frame that is
+ * neither pinned nor recently used through any of its pages, and
+ * returns it.  Returns a null pointer if there is none after two
+ * full sweeps. */
+static struct frame *
+clock_victim(void)
+{
+    size_t sweep = 2 * list_size(&frames);
+
+    while (sweep-- > 0) {
+        struct frame *f = clock_next();
+        bool accessed = false;
+        struct list_elem *e;
+
+        if (f->pin_cnt > 0) {
+            continue;
+        }
+        for (e = list_begin(&f->pages); e != list_end(&f->pages);
+             e = list_next(e)) {
+            struct page *p = list_entry(e, struct page, frame_elem);
+            uint32_t *pd = p->owner->pagedir;
+
+            if (pagedir_is_accessed(pd, p->upage)) {
+                pagedir_set_accessed(pd, p->upage, false);
+                accessed = true;
+            }
+        }
+        if (!accessed) {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the frame under the clock hand and advances the hand.
+ * The frame table must not be empty. */
+static struct frame *
+clock_next(void)
+{
+    struct list_elem *e;
+
+    if (clock_hand == list_end(&frames)) {
+        clock_hand = list_begin(&frames);
+    }
+    e = clock_hand;
+    clock_hand = list_next(clock_hand);
+    return list_entry(e, struct frame, elem);
+}
+
+/* Removes F, which no page maps, from the frame table and
+ * returns its page to the user pool. */
+static void
+frame_destroy(struct frame *f)
+{
+    ASSERT(list_empty(&f->pages));
+
+    if (clock_hand == &f->elem) {
+        clock_hand = list_next(clock_hand);
+    }
+    list_remove(&f->elem);
+    palloc_free_page(f->kpage);
+    free(f);
+}
+
+/* Returns the shared frame holding READ_BYTES bytes of INODE at
+ * offset OFS, or a null pointer if there is none. */
+static struct frame *
+shared_find(struct inode *inode, off_t ofs, size_t read_bytes)
+{
+    struct frame key;
+    struct hash_elem *e;
+
+    key.inode = inode;
+    key.ofs = ofs;
+    key.read_bytes = read_bytes;
+    e = hash_find(&shared_frames, &key.share_elem);
+    return e != NULL ? hash_entry(e, struct frame, share_elem) : NULL;
+}
+
+/* Returns a hash value for the shared frame that E refers to. */
+static unsigned
+shared_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    const struct frame *f = hash_entry(e, struct frame, share_elem);
+    return hash_bytes(&f->inode, sizeof f->inode) ^ hash_int(f->ofs);
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+shared_less(const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+    const struct frame *a = hash_entry(a_, struct frame, share_elem);
+    const struct frame *b = hash_entry(b_, struct frame, share_elem);
+
+    if (a->inode != b->inode) {
+        return a->inode < b->inode;
+    } else if (a->ofs != b->ofs) {
+        return a->ofs < b->ofs;
+    } else {
+        return a->read_bytes < b->read_bytes;
+    }
+}
+
+/* Page-out daemon.  Whenever the user pool runs low, writes out
+ * clusters of pages until it is back above the low-water mark
+ * or nothing more can be evicted, so that faults seldom have to
+ * wait for a write. */
+static void
+pageout_daemon(void *aux UNUSED)
+{
+    struct frame *victims[PAGEOUT_BATCH];
+    size_t cnt, i;
+
+    lock_acquire(&frame_lock);
+    for (;;) {
+        cond_wait(&pageout_wanted, &frame_lock);
+        while (palloc_free_cnt(PAL_USER) < PAGEOUT_LOW_WATER
+               && (cnt = page_out(victims, PAGEOUT_BATCH)) > 0) {
+            for (i = 0; i < cnt; i++) {
+                frame_destroy(victims[i]);
+            }
+        }
+    }
+}
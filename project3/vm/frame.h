@@ -0,0 +1,45 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+
+/* A frame of the user pool holding a user page.
+ *
+ * A private frame is mapped by one page, or read-only by the
+ * copies of a page in processes forked from one another, until
+ * each of them writes to it.  A shared frame holds a region of a
+ * file and is mapped by every page, in any process, that maps
+ * that region; it is written back to the file rather than to
+ * swap. */
+struct frame {
+    void            *kpage;      /* Kernel virtual address. */
+    struct list      pages;      /* Pages mapping the frame. */
+    unsigned         pin_cnt;    /* Not to be evicted while nonzero. */
+    bool             busy;       /* Contents being read in or written out. */
+    bool             dirty;      /* Modified through a page since unmapped. */
+
+    /* Shared frames only. */
+    struct inode    *inode;      /* File, or null for a private frame. */
+    off_t            ofs;        /* Offset in INODE. */
+    size_t           read_bytes; /* Bytes of INODE in the frame. */
+    struct hash_elem share_elem; /* Element in the shared frame index. */
+
+    struct list_elem elem;       /* Element in the frame table. */
+};
+
+void frame_init(void);
+bool frame_alloc(struct page *, struct frame **, bool *fresh);
+bool frame_map_zero(struct page *);
+void frame_unpin(struct frame *);
+void frame_free(struct page *);
+bool frame_fork(struct page *parent, struct page *);
+bool frame_unshare(struct page *);
+
+#endif /* vm/frame.h */
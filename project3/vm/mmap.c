@@ -0,0 +1,193 @@
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+
+/* A file mapped into a process's address space.  Each process
+ * keeps its mappings in the `mappings' list of its struct
+ * thread, which only it touches. */
+struct mapping {
+    int              id;       /* Mapping identifier. */
+    struct file     *file;     /* Our own handle on the file. */
+    uint8_t         *addr;     /* First page of the mapping. */
+    size_t           page_cnt; /* Number of pages mapped. */
+    struct list_elem elem;     /* Element in the thread's mappings. */
+};
+
+static struct mapping *mapping_find(int mapid);
+static void mapping_destroy(struct mapping *, size_t page_cnt);
+
+/* Maps all of FILE into the running process at ADDR, which must
+ * be page-aligned.  The pages are brought in on demand and shared
+ * with other mappings of the same file.  The mapping keeps its
+ * own handle on FILE, so it survives the file being closed.
+ * Returns the new mapping's identifier, or MAP_FAILED if FILE is
+ * empty, the pages at ADDR are not all free and below the stack
+ * region, or memory is exhausted. */
+int
+mmap_map(struct file *file, void *addr)
+{
+    struct thread *t = thread_current();
+    uint8_t *stack_bottom = (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE;
+    off_t length = file_length(file);
+    struct mapping *m;
+    size_t i;
+
+    if (addr == NULL || pg_ofs(addr) != 0 || length == 0) {
+        return MAP_FAILED;
+    }
+
+    m = malloc(sizeof *m);
+    if (m == NULL) {
+        return MAP_FAILED;
+    }
+    m->addr = addr;
+    m->page_cnt = DIV_ROUND_UP(length, PGSIZE);
+    for (i = 0; i < m->page_cnt; i++) {
+        uint8_t *upage = m->addr + i * PGSIZE;
+        if (upage < m->addr || upage >= stack_bottom
+            || page_lookup(upage) != NULL) {
+            free(m);
+            return MAP_FAILED;
+        }
+    }
+
+    m->file = file_reopen(file);
+    if (m->file == NULL) {
+        free(m);
+        return MAP_FAILED;
+    }
+    for (i = 0; i < m->page_cnt; i++) {
+        off_t ofs = i * PGSIZE;
+        size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+        if (!page_add_mmap(m->addr + ofs, m->file, ofs, read_bytes)) {
+            mapping_destroy(m, i);
+            return MAP_FAILED;
+        }
+    }
+
+    m->id = t->next_mapid++;
+    list_push_back(&t->mappings, &m->elem);
+    return m->id;
+}
+
+/* Unmaps the running process's mapping MAPID, writing its
+ * modified pages back to the file.  Returns false if there is no
+ * such mapping. */
+bool
+mmap_unmap(int mapid)
+{
+    struct mapping *m = mapping_find(mapid);
+
+    if (m == NULL) {
+        return false;
+    }
+    list_remove(&m->elem);
+    mapping_destroy(m, m->page_cnt);
+    return true;
+}
+
+/* Unmaps all of the running process's mappings. */
+void
+mmap_unmap_all(void)
+{
+    struct thread *t = thread_current();
+
+    while (!list_empty(&t->mappings)) {
+        struct list_elem *e = list_pop_front(&t->mappings);
+        struct mapping *m = list_entry(e, struct mapping, elem);
+        mapping_destroy(m, m->page_cnt);
+    }
+}
+
+/* Gives the running process, which must have no mappings, a copy
+ * of each of PARENT's mappings, with the same identifier and
+ * address and its own handle on the file.  Only the mapping
+ * records are copied; page_table_fork() copies the pages.
+ * Returns false if memory is exhausted. */
+bool
+mmap_fork(struct thread *parent)
+{
+    struct thread *t = thread_current();
+    struct list_elem *e;
+
+    ASSERT(list_empty(&t->mappings));
+
+    for (e = list_begin(&parent->mappings); e != list_end(&parent->mappings);
+         e = list_next(e)) {
+        struct mapping *pm = list_entry(e, struct mapping, elem);
+        struct mapping *m = malloc(sizeof *m);
+
+        if (m == NULL) {
+            return false;
+        }
+        m->file = file_reopen(pm->file);
+        if (m->file == NULL) {
+            free(m);
+            return false;
+        }
+        m->id = pm->id;
+        m->addr = pm->addr;
+        m->page_cnt = pm->page_cnt;
+        list_push_back(&t->mappings, &m->elem);
+    }
+    t->next_mapid = parent->next_mapid;
+    return true;
+}
+
+/* Returns the file behind the running process's mapping that
+ * covers UPAGE, or a null pointer if no mapping does. */
+struct file *
+mmap_file(const void *upage)
+{
+    struct thread *t = thread_current();
+    struct list_elem *e;
+
+    for (e = list_begin(&t->mappings); e != list_end(&t->mappings);
+         e = list_next(e)) {
+        struct mapping *m = list_entry(e, struct mapping, elem);
+        if ((const uint8_t *) upage >= m->addr
+            && (const uint8_t *) upage < m->addr + m->page_cnt * PGSIZE) {
+            return m->file;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the running process's mapping MAPID, or a null pointer
+ * if there is none. */
+static struct mapping *
+mapping_find(int mapid)
+{
+    struct thread *t = thread_current();
+    struct list_elem *e;
+
+    for (e = list_begin(&t->mappings); e != list_end(&t->mappings);
+         e = list_next(e)) {
+        struct mapping *m = list_entry(e, struct mapping, elem);
+        if (m->id == mapid) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+/* Removes the first PAGE_CNT pages of M, closes its file and
+ * frees it.  M must not be in the thread's list. */
+static void
+mapping_destroy(struct mapping *m, size_t page_cnt)
+{
+    size_t i;
+
+    for (i = 0; i < page_cnt; i++) {
+        page_remove(m->addr + i * PGSIZE);
+    }
+    file_close(m->file);
+    free(m);
+}
@@ -0,0 +1,325 @@
+#include <debug.h>
+#include <string.h>
+
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Each process's supplemental page table is a hash of struct
+ * page keyed by user virtual page.  It is only ever touched by
+ * the process that owns it, from system calls, page faults and
+ * process exit, so it needs no lock. */
+
+size_t stack_page_limit = STACK_PAGE_LIMIT_DEFAULT;
+
+static struct page *page_add(void *upage, struct file *, off_t ofs,
+                             size_t read_bytes, bool writable, bool shared);
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_free;
+
+/* Creates an empty supplemental page table for the running
+ * process.  Returns false if memory is exhausted. */
+bool
+page_table_create(void)
+{
+    struct thread *t = thread_current();
+
+    ASSERT(t->pages == NULL);
+
+    t->pages = malloc(sizeof *t->pages);
+    if (t->pages == NULL) {
+        return false;
+    }
+    if (!hash_init(t->pages, page_hash, page_less, NULL)) {
+        free(t->pages);
+        t->pages = NULL;
+        return false;
+    }
+    return true;
+}
+
+/* Fills the running process's empty supplemental page table with
+ * a copy of PARENT's.  The running process must already have its
+ * own handle on PARENT's executable and copies of PARENT's
+ * mappings, which the copied pages are backed by instead.  Pages
+ * that PARENT has in memory are not copied but shared, see
+ * frame_fork().  Returns false if memory is exhausted. */
+bool
+page_table_fork(struct thread *parent)
+{
+    struct thread *t = thread_current();
+    struct hash_iterator i;
+
+    hash_first(&i, parent->pages);
+    while (hash_next(&i)) {
+        struct page *pp = hash_entry(hash_cur(&i), struct page, elem);
+        struct file *file = pp->file;
+        struct page *p;
+
+        if (file != NULL) {
+            file = (file == parent->file_executable ? t->file_executable
+                                                     : mmap_file(pp->upage));
+        }
+        p = page_add(pp->upage, file, pp->ofs, pp->read_bytes,
+                     pp->writable, pp->shared);
+        if (p == NULL || !frame_fork(pp, p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Destroys the running process's supplemental page table, if it
+ * has one, freeing the frames and swap slots of its pages.  Must
+ * be called before the page directory is destroyed. */
+void
+page_table_destroy(void)
+{
+    struct thread *t = thread_current();
+
+    if (t->pages != NULL) {
+        hash_destroy(t->pages, page_free);
+        free(t->pages);
+        t->pages = NULL;
+    }
+}
+
+/* Records that the page at UPAGE is to be filled with
+ * READ_BYTES bytes of FILE starting at offset OFS, followed by
+ * zeros, the first time it is touched.  FILE may be null if
+ * READ_BYTES is 0.  FILE must stay open for as long as the page
+ * can be loaded.  Returns false if UPAGE already has an entry or
+ * memory is exhausted.
+ *
+ * A read-only page with data from FILE, such as a page of program
+ * text, can never differ from the file, so it is made a shared
+ * page: every process that maps the same part of the same file
+ * uses the same frame, and only the first reads it in. */
+bool
+page_add_file(void *upage, struct file *file, off_t ofs,
+              size_t read_bytes, bool writable)
+{
+    bool shared = !writable && read_bytes > 0;
+    return page_add(upage, file, ofs, read_bytes, writable, shared) != NULL;
+}
+
+/* Like page_add_file(), but maps the page writably onto FILE
+ * itself: changes are written back to FILE, not to swap, and the
+ * frame is shared with other mappings of the same region.
+ * READ_BYTES must not be 0. */
+bool
+page_add_mmap(void *upage, struct file *file, off_t ofs,
+              size_t read_bytes)
+{
+    ASSERT(read_bytes > 0);
+    return page_add(upage, file, ofs, read_bytes, true, true) != NULL;
+}
+
+/* Removes the running process's page at UPAGE, if it has one,
+ * writing it back to its file first if it is shared and dirty.
+ * A fork that fails part way can leave mappings whose pages were
+ * never added. */
+void
+page_remove(void *upage)
+{
+    struct thread *t = thread_current();
+    struct page *p = page_lookup(upage);
+
+    if (p != NULL) {
+        hash_delete(t->pages, &p->elem);
+        page_free(&p->elem, NULL);
+    }
+}
+
+/* Adds a page at UPAGE to the running process's table and
+ * returns it, or a null pointer on failure.  See page_add_file()
+ * and page_add_mmap(). */
+static struct page *
+page_add(void *upage, struct file *file, off_t ofs,
+         size_t read_bytes, bool writable, bool shared)
+{
+    struct thread *t = thread_current();
+    struct page *p;
+
+    ASSERT(pg_ofs(upage) == 0);
+    ASSERT(read_bytes <= PGSIZE);
+    ASSERT(file != NULL || read_bytes == 0);
+
+    p = malloc(sizeof *p);
+    if (p == NULL) {
+        return NULL;
+    }
+    p->upage = upage;
+    p->owner = t;
+    p->writable = writable;
+    p->shared = shared;
+    p->file = file;
+    p->ofs = ofs;
+    p->read_bytes = read_bytes;
+    p->frame = NULL;
+    p->swap_slot = SWAP_NONE;
+    if (hash_insert(t->pages, &p->elem) != NULL) {
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+/* Returns the running process's entry for the page containing
+ * UADDR, or a null pointer if it has none. */
+struct page *
+page_lookup(const void *uaddr)
+{
+    struct thread *t = thread_current();
+    struct page p;
+    struct hash_elem *e;
+
+    if (t->pages == NULL) {
+        return NULL;
+    }
+    p.upage = pg_round_down(uaddr);
+    e = hash_find(t->pages, &p.elem);
+    return e != NULL ? hash_entry(e, struct page, elem) : NULL;
+}
+
+/* Brings in the not-present page containing FAULT_ADDR, which
+ * the running process tried to write if WRITE is true or read
+ * otherwise.  Returns true if the access can be retried, false
+ * if it is invalid or memory is exhausted. */
+bool
+page_load(const void *fault_addr, bool write)
+{
+    struct thread *t = thread_current();
+    struct page *p;
+    struct frame *f;
+    uint8_t *kpage;
+    bool fresh;
+
+    if (!is_user_vaddr(fault_addr)) {
+        return false;
+    }
+    p = page_lookup(fault_addr);
+    if (p == NULL || (write && !p->writable)) {
+        return false;
+    }
+    if (pagedir_get_page(t->pagedir, p->upage) != NULL) {
+        /* Mapped again by an eviction that had nowhere to write
+         * it. */
+        return true;
+    }
+
+    /* Reading a page that is still all zeros maps the zero frame.
+     * The first write gets it a frame of its own, see
+     * page_unshare(). */
+    if (!write && p->read_bytes == 0 && p->swap_slot == SWAP_NONE
+        && frame_map_zero(p)) {
+        return true;
+    }
+
+    if (!frame_alloc(p, &f, &fresh)) {
+        return false;
+    }
+    if (f == NULL) {
+        return true;
+    }
+    kpage = f->kpage;
+    if (!fresh) {
+        /* Already filled by another mapping of the file. */
+    } else if (p->swap_slot != SWAP_NONE) {
+        swap_read(p->swap_slot, kpage);
+    } else {
+        if (p->read_bytes > 0
+            && file_read_at(p->file, kpage, p->read_bytes, p->ofs)
+               != (off_t) p->read_bytes) {
+            frame_unpin(f);
+            frame_free(p);
+            return false;
+        }
+        memset(kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+
+    if (!pagedir_set_page(t->pagedir, p->upage, kpage, p->writable)) {
+        frame_unpin(f);
+        frame_free(p);
+        return false;
+    }
+    frame_unpin(f);
+    return true;
+}
+
+/* Gives the running process its own copy of the present,
+ * read-only page containing FAULT_ADDR, which it tried to write,
+ * if the page is writable but shares its frame copy-on-write with
+ * another process or is mapped to the zero frame.  Returns true if
+ * the access can be retried. */
+bool
+page_unshare(const void *fault_addr)
+{
+    struct page *p;
+
+    if (!is_user_vaddr(fault_addr)) {
+        return false;
+    }
+    p = page_lookup(fault_addr);
+    if (p == NULL || !p->writable || p->shared) {
+        return false;
+    }
+    return frame_unshare(p);
+}
+
+/* Grows the running process's stack to cover FAULT_ADDR, if
+ * that looks like a stack access given the user stack pointer
+ * ESP: no more than 32 bytes below ESP, which is as far as PUSHA
+ * reaches, and within stack_page_limit pages of the top of user
+ * memory.  Returns true if the new page was brought in. */
+bool
+page_grow_stack(const void *fault_addr, const void *esp)
+{
+    uint8_t *upage = pg_round_down(fault_addr);
+
+    if (thread_current()->pages == NULL || !is_user_vaddr(fault_addr)
+        || (const uint8_t *) fault_addr < (const uint8_t *) esp - 32
+        || upage < (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE) {
+        return false;
+    }
+    return page_add_file(upage, NULL, 0, 0, true) && page_load(upage, true);
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    const struct page *p = hash_entry(e, struct page, elem);
+    return hash_bytes(&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less(const struct hash_elem *a, const struct hash_elem *b,
+          void *aux UNUSED)
+{
+    const struct page *pa = hash_entry(a, struct page, elem);
+    const struct page *pb = hash_entry(b, struct page, elem);
+    return pa->upage < pb->upage;
+}
+
+/* Frees the page that E refers to, with its frame and swap
+ * slot. */
+static void
+page_free(struct hash_elem *e, void *aux UNUSED)
+{
+    struct page *p = hash_entry(e, struct page, elem);
+
+    frame_free(p);
+    if (p->swap_slot != SWAP_NONE) {
+        swap_free(p->swap_slot);
+    }
+    free(p);
+}
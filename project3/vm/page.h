@@ -0,0 +1,67 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "filesys/off_t.h"
+
+struct file;
+struct thread;
+
+/* Default for the maximum size of a user stack, in pages. */
+#define STACK_PAGE_LIMIT_DEFAULT 2048
+
+/* Maximum size of a user stack, in pages.  Set with "-sl". */
+extern size_t stack_page_limit;
+
+/* A page of user virtual memory that is not necessarily resident.
+ * Each process keeps one of these per page of its address space
+ * so that page_fault() knows how to bring the page in.  Once a
+ * page has been written to swap it keeps its slot, and is read
+ * back from there rather than from FILE, until the process
+ * exits.  After a fork the parent's and the child's copies of a
+ * page share its frame and swap slot until either one writes.
+ *
+ * A shared page is backed by its file, not by swap: its frame is
+ * shared with every other page mapping the same part of the same
+ * file, and changes are written back to the file.  Mapped files
+ * and read-only pages of executables are shared. */
+struct page {
+    void            *upage;      /* User virtual address. */
+    struct thread   *owner;      /* Process whose page this is. */
+    bool             writable;   /* False for read-only pages. */
+    bool             shared;     /* Backed by FILE rather than swap. */
+
+    /* Backing store: READ_BYTES bytes of FILE at offset OFS,
+     * followed by PGSIZE - READ_BYTES zero bytes.  FILE is null
+     * for pages that are entirely zero. */
+    struct file     *file;
+    off_t            ofs;
+    size_t           read_bytes;
+
+    /* Owned by vm/frame.c. */
+    struct frame    *frame;      /* Frame holding the page, or null. */
+    size_t           swap_slot;  /* Saved copy, or SWAP_NONE. */
+    struct list_elem frame_elem; /* Element in the frame's pages. */
+
+    struct hash_elem elem;       /* Element in the thread's table. */
+};
+
+bool page_table_create(void);
+void page_table_destroy(void);
+bool page_table_fork(struct thread *parent);
+
+bool page_add_file(void *upage, struct file *, off_t ofs,
+                   size_t read_bytes, bool writable);
+bool page_add_mmap(void *upage, struct file *, off_t ofs,
+                   size_t read_bytes);
+void page_remove(void *upage);
+struct page *page_lookup(const void *uaddr);
+bool page_load(const void *fault_addr, bool write);
+bool page_unshare(const void *fault_addr);
+bool page_grow_stack(const void *fault_addr, const void *esp);
+
+#endif /* vm/page.h */
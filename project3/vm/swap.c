@@ -0,0 +1,159 @@
+#include <bitmap.h>
+#include <debug.h>
+#include <limits.h>
+#include <stdio.h>
+
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+
+/* Number of sectors in a swap slot. */
+#define SLOT_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* The swap device, or null if there is none.  Each slot has a
+ * bit in swap_slots, set while the slot is in use, and a count
+ * of the pages that refer to it in swap_refs.  Both are
+ * protected by swap_lock, as are the statistics; a slot's
+ * sectors belong to whoever holds a reference to it. */
+static struct block *swap_device;
+static struct bitmap *swap_slots;
+static unsigned short *swap_refs;
+static struct lock swap_lock;
+
+/* Statistics. */
+static unsigned long long swap_in_cnt;    /* Pages read. */
+static unsigned long long swap_out_cnt;   /* Pages written. */
+static unsigned long long swap_batch_cnt; /* Runs of pages written. */
+
+/* Initializes the swap partition manager.  Runs without swap if
+ * no device has the swap role, in which case swap_alloc() always
+ * fails. */
+void
+swap_init(void)
+{
+    size_t slot_cnt;
+
+    lock_init(&swap_lock);
+    swap_device = block_get_role(BLOCK_SWAP);
+    if (swap_device == NULL) {
+        printf("swap: no swap device, pages will not be swapped\n");
+        return;
+    }
+    slot_cnt = block_size(swap_device) / SLOT_SECTORS;
+    swap_slots = bitmap_create(slot_cnt);
+    swap_refs = calloc(slot_cnt, sizeof *swap_refs);
+    if (swap_slots == NULL || swap_refs == NULL) {
+        PANIC("can't create swap slot table");
+    }
+}
+
+/* Allocates CNT contiguous free swap slots, each with one
+ * reference, and returns the first, or SWAP_NONE if there is no
+ * such run or no swap device. */
+size_t
+swap_alloc(size_t cnt)
+{
+    size_t slot, i;
+
+    if (swap_slots == NULL) {
+        return SWAP_NONE;
+    }
+    lock_acquire(&swap_lock);
+    slot = bitmap_scan_and_flip(swap_slots, 0, cnt, false);
+    if (slot != SWAP_NONE) {
+        for (i = 0; i < cnt; i++) {
+            swap_refs[slot + i] = 1;
+        }
+    }
+    lock_release(&swap_lock);
+    return slot;
+}
+
+/* Adds a reference to SLOT, which must be in use. */
+void
+swap_ref(size_t slot)
+{
+    lock_acquire(&swap_lock);
+    ASSERT(bitmap_test(swap_slots, slot));
+    ASSERT(swap_refs[slot] < USHRT_MAX);
+    swap_refs[slot]++;
+    lock_release(&swap_lock);
+}
+
+/* Drops a reference to SLOT, making it available for reuse once
+ * the last one is gone. */
+void
+swap_free(size_t slot)
+{
+    lock_acquire(&swap_lock);
+    ASSERT(bitmap_test(swap_slots, slot));
+    ASSERT(swap_refs[slot] > 0);
+    if (--swap_refs[slot] == 0) {
+        bitmap_reset(swap_slots, slot);
+    }
+    lock_release(&swap_lock);
+}
+
+/* Returns true if more than one page refers to SLOT, in which
+ * case it must not be overwritten. */
+bool
+swap_shared(size_t slot)
+{
+    bool shared;
+
+    lock_acquire(&swap_lock);
+    shared = swap_refs[slot] > 1;
+    lock_release(&swap_lock);
+    return shared;
+}
+
+/* Reads the page saved in SLOT into KPAGE. */
+void
+swap_read(size_t slot, void *kpage)
+{
+    block_sector_t sector = slot * SLOT_SECTORS;
+    size_t i;
+
+    ASSERT(slot < bitmap_size(swap_slots));
+    for (i = 0; i < SLOT_SECTORS; i++) {
+        block_read(swap_device, sector + i,
+                   (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+    }
+
+    lock_acquire(&swap_lock);
+    swap_in_cnt++;
+    lock_release(&swap_lock);
+}
+
+/* Writes the CNT pages in KPAGES to the CNT consecutive slots
+ * starting at SLOT, as one sequential pass over the device. */
+void
+swap_write(size_t slot, void *const kpages[], size_t cnt)
+{
+    block_sector_t sector = slot * SLOT_SECTORS;
+    size_t i;
+
+    ASSERT(slot + cnt <= bitmap_size(swap_slots));
+    for (i = 0; i < cnt * SLOT_SECTORS; i++) {
+        block_write(swap_device, sector + i,
+                    (const uint8_t *) kpages[i / SLOT_SECTORS]
+                    + i % SLOT_SECTORS * BLOCK_SECTOR_SIZE);
+    }
+
+    lock_acquire(&swap_lock);
+    swap_out_cnt += cnt;
+    swap_batch_cnt++;
+    lock_release(&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats(void)
+{
+    if (swap_device != NULL) {
+        printf("Swap: %llu pages in, %llu pages out in %llu runs\n",
+               swap_in_cnt, swap_out_cnt, swap_batch_cnt);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <bitmap.h>
+#include <stddef.h>
+
+/* A swap slot holds one page.  SWAP_NONE is never a valid slot. */
+#define SWAP_NONE BITMAP_ERROR
+
+void swap_init(void);
+size_t swap_alloc(size_t cnt);
+void swap_ref(size_t slot);
+void swap_free(size_t slot);
+bool swap_shared(size_t slot);
+void swap_read(size_t slot, void *kpage);
+void swap_write(size_t slot, void *const kpages[], size_t cnt);
+void swap_print_stats(void);
+
+#endif /* vm/swap.h */